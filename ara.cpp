@@ -0,0 +1,289 @@
+#include "ara.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "grid.hpp"
+#include "render.hpp"
+#include "search.hpp"
+
+namespace ara {
+using search::between;
+using search::dirs;
+using search::index;
+
+constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+// reading the clock on every expansion would cost more than the expansion
+constexpr size_t EXPANSIONS_PER_CLOCK_CHECK = 64;
+// the same between iterations, for entries of OPEN and INCONS looked at
+constexpr size_t ENTRIES_PER_CLOCK_CHECK = 1024;
+
+grid<int> *current_grid = nullptr;
+int width, height;
+int start_x, start_y, goal_x, goal_y;
+double epsilon, epsilon_step;
+
+std::vector<double> cost_so_far;
+std::vector<uint32_t> came_from;
+// a cell is closed when its stamp matches the current iteration, so clearing
+// CLOSED between iterations is just a bump of `iteration`
+std::vector<uint32_t> closed;
+uint32_t iteration;
+std::vector<char> in_open;
+// cells whose cost dropped after they were closed this iteration; they go
+// back into OPEN when epsilon is lowered
+std::vector<uint32_t> incons;
+std::vector<char> in_incons;
+
+using entry = std::pair<double, uint32_t>;  // key, index
+std::vector<entry> open;  // min-heap, may hold stale entries
+
+// between two ImprovePaths, every entry of OPEN and INCONS is looked at twice:
+// once for the bound on the path just found, and once to move it over to the
+// next epsilon. on big maps that alone can take longer than a frame, so it's
+// done in slices too, `scanned` entries at a time
+enum class phase { search, bound, requeue };
+phase current_phase;
+size_t scanned;
+double lower_bound;
+std::vector<entry> next_open;
+
+bool initialized = false;
+bool done = false;
+result best_result;
+size_t expanded;
+size_t solutions;
+
+inline double heuristic(size_t idx) {
+    return search::octile(idx % width, idx / width, goal_x, goal_y);
+}
+
+inline double key(size_t idx) {
+    return cost_so_far[idx] + epsilon * heuristic(idx);
+}
+
+inline void push_open(uint32_t idx) {
+    in_open[idx] = true;
+    open.emplace_back(key(idx), idx);
+    std::push_heap(open.begin(), open.end(), std::greater<entry>());
+}
+
+// drops stale entries off the top of OPEN; false when it runs dry
+bool settle_top() {
+    while (!open.empty()) {
+        auto [top_key, idx] = open.front();
+        if (in_open[idx] && top_key == key(idx))
+            return true;
+        std::pop_heap(open.begin(), open.end(), std::greater<entry>());
+        open.pop_back();
+    }
+    return false;
+}
+
+// one ara* ImprovePath; false if the deadline came first, in which case the
+// next call carries on where this one stopped
+bool improve_path(std::chrono::steady_clock::time_point deadline) {
+    size_t goal = index(goal_x, goal_y, width);
+    for (size_t n = 1; settle_top() && key(goal) > open.front().first; n++) {
+        if (n % EXPANSIONS_PER_CLOCK_CHECK == 0 &&
+            std::chrono::steady_clock::now() >= deadline)
+            return false;
+
+        uint32_t u = open.front().second;
+        std::pop_heap(open.begin(), open.end(), std::greater<entry>());
+        open.pop_back();
+        in_open[u] = false;
+        closed[u] = iteration;
+        expanded++;
+
+        int ux = u % width, uy = u / width;
+        for (int k = 0; k < 8; k++) {
+            int vx = ux + dirs[k].first;
+            int vy = uy + dirs[k].second;
+            if (!between(vx, 0, width) || !between(vy, 0, height) ||
+                (*current_grid)[vy][vx] == IMPASSABLE)
+                continue;
+            uint32_t v = index(vx, vy, width);
+            double cost = cost_so_far[u] + (k < 4 ? 1 : search::SQRT2);
+            if (cost >= cost_so_far[v])
+                continue;
+            cost_so_far[v] = cost;
+            came_from[v] = u;
+            if (closed[v] != iteration) {
+                push_open(v);
+            } else if (!in_incons[v]) {
+                in_incons[v] = true;
+                incons.push_back(v);
+            }
+        }
+    }
+    return true;
+}
+
+inline bool out_of_time(std::chrono::steady_clock::time_point deadline) {
+    return scanned % ENTRIES_PER_CLOCK_CHECK == 0 &&
+           std::chrono::steady_clock::now() >= deadline;
+}
+
+// the entry of OPEN followed by INCONS that `scanned` is at
+inline uint32_t scanned_cell() {
+    return scanned < open.size() ? open[scanned].second
+                                 : incons[scanned - open.size()];
+}
+
+// every cell still in OPEN or INCONS bounds the optimal cost from below; false
+// if the deadline came first
+bool scan_bound(std::chrono::steady_clock::time_point deadline) {
+    for (; scanned < open.size() + incons.size(); scanned++) {
+        if (out_of_time(deadline))
+            return false;
+        uint32_t idx = scanned_cell();
+        if (scanned >= open.size() || in_open[idx])
+            lower_bound =
+                std::min(lower_bound, cost_so_far[idx] + heuristic(idx));
+    }
+    return true;
+}
+
+// moves INCONS back into OPEN and re-keys everything under the new epsilon,
+// then starts a fresh CLOSED; false if the deadline came first
+bool requeue(std::chrono::steady_clock::time_point deadline) {
+    for (; scanned < open.size() + incons.size(); scanned++) {
+        if (out_of_time(deadline))
+            return false;
+        uint32_t idx = scanned_cell();
+        if (scanned < open.size()) {
+            // cells already moved over are marked closed, so stale copies
+            // are skipped; the bump of `iteration` reopens them all
+            if (!in_open[idx] || closed[idx] == iteration)
+                continue;
+        } else {
+            in_incons[idx] = false;
+            in_open[idx] = true;
+        }
+        closed[idx] = iteration;
+        next_open.emplace_back(key(idx), idx);
+        std::push_heap(next_open.begin(), next_open.end(),
+                       std::greater<entry>());
+    }
+    open.swap(next_open);
+    next_open.clear();
+    incons.clear();
+    iteration++;
+    return true;
+}
+
+// records the current path and how far from optimal it can be
+void publish() {
+    size_t goal = index(goal_x, goal_y, width);
+    if (cost_so_far[goal] == UNREACHED) {
+        best_result.bound = UNREACHED;
+        return;
+    }
+    best_result.epsilon = epsilon;
+    best_result.bound =
+        cost_so_far[goal] <= lower_bound
+            ? 1.0
+            : std::min(epsilon, cost_so_far[goal] / lower_bound);
+    if (best_result.path_length == cost_so_far[goal])
+        return;  // same path as last time
+
+    best_result.path_length = cost_so_far[goal];
+    best_result.path.clear();
+    for (uint32_t idx = goal; idx != NONE; idx = came_from[idx])
+        best_result.path.emplace_back(idx % width, idx / width);
+    std::reverse(best_result.path.begin(), best_result.path.end());
+    solutions++;
+}
+
+void init(grid<int> &world, int _start_x, int _start_y, int _goal_x,
+          int _goal_y, double _epsilon, double _epsilon_step) {
+    current_grid = &world;
+    width = world.width();
+    height = world.height();
+    start_x = _start_x;
+    start_y = _start_y;
+    goal_x = _goal_x;
+    goal_y = _goal_y;
+    epsilon = std::max(1.0, _epsilon);
+    epsilon_step = _epsilon_step;
+
+    size_t cells = static_cast<size_t>(width) * height;
+    cost_so_far.assign(cells, UNREACHED);
+    came_from.assign(cells, NONE);
+    closed.assign(cells, 0);
+    iteration = 1;
+    in_open.assign(cells, false);
+    in_incons.assign(cells, false);
+    incons.clear();
+    open.clear();
+    current_phase = phase::search;
+
+    best_result = result{{}, 0, epsilon, UNREACHED};
+    expanded = 0;
+    solutions = 0;
+
+    cost_so_far[index(start_x, start_y, width)] = 0;
+    push_open(index(start_x, start_y, width));
+    initialized = true;
+    done = false;
+}
+
+bool improve(std::chrono::steady_clock::time_point deadline) {
+    if (!initialized || done)
+        return done;
+    while (true) {
+        switch (current_phase) {
+        case phase::search:
+            if (!improve_path(deadline))
+                return false;
+            current_phase = phase::bound;
+            scanned = 0;
+            lower_bound = UNREACHED;
+            break;
+        case phase::bound:
+            if (!scan_bound(deadline))
+                return false;
+            publish();
+            if (best_result.bound == UNREACHED || epsilon <= 1 ||
+                best_result.bound <= 1) {
+                // either there's no path at all or this one is optimal
+                done = true;
+                return true;
+            }
+            epsilon = std::max(1.0, epsilon - epsilon_step);
+            current_phase = phase::requeue;
+            scanned = 0;
+            break;
+        case phase::requeue:
+            if (!requeue(deadline))
+                return false;
+            current_phase = phase::search;
+            break;
+        }
+    }
+}
+
+const result &best() { return best_result; }
+
+void reset() {
+    initialized = false;
+    done = false;
+    current_grid = nullptr;
+    open.clear();
+    incons.clear();
+    next_open.clear();
+    current_phase = phase::search;
+    best_result = result{};
+}
+
+stats get_stats() {
+    return stats{epsilon, best_result.bound, expanded, solutions};
+}
+}  // namespace ara
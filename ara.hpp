@@ -0,0 +1,39 @@
+#pragma once
+
+#include "grid.hpp"
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+namespace ara {
+// anytime repairing a*: finds a path with an inflated heuristic first, then
+// keeps tightening epsilon and reusing the search state to improve it, for as
+// long as the caller's deadlines allow
+
+struct result {
+    std::vector<std::pair<int, int>> path;
+    double path_length;
+    // inflation the path was found with
+    double epsilon;
+    // the path is at most this many times longer than the optimal one
+    double bound;
+};
+
+struct stats {
+    double epsilon;
+    double bound;
+    size_t expanded;
+    size_t solutions;
+};
+
+extern bool initialized;
+extern bool done;
+
+void init(grid<int> &world, int start_x, int start_y, int goal_x, int goal_y,
+          double epsilon = 3.0, double epsilon_step = 0.5);
+bool improve(std::chrono::steady_clock::time_point deadline);
+const result &best();
+void reset();
+stats get_stats();
+}  // namespace ara
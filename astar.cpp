@@ -3,19 +3,99 @@
 #include <algorithm>
 #include <cmath>
 #include <deque>
+#include <filesystem>
 #include <functional>
+#include <limits>
 #include <list>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
 #include <fmt/core.h>
 
+#include <unistd.h>
+
 #include "grid.hpp"
 #include "logs.hpp"
 #include "render.hpp"
+#include "search.hpp"
+#include "tiled.hpp"
 
 namespace astar {
+// the map being searched: either the one on screen, whose cells change
+// through render::update() so they get drawn, or one that lives on disk
 grid<int> *current_grid = nullptr;
+tiled_grid *current_tiles = nullptr;
+
+inline int cell(int x, int y) {
+    return current_tiles ? current_tiles->get(x, y) : (*current_grid)[y][x];
+}
+
+inline void set_cell(int x, int y, int val) {
+    if (current_tiles)
+        current_tiles->set(x, y, val);
+    else
+        render::update(x, y, val);
+}
+
+inline int grid_width() {
+    return current_tiles ? current_tiles->width() : current_grid->width();
+}
+
+inline int grid_height() {
+    return current_tiles ? current_tiles->height() : current_grid->height();
+}
+
+// a map on disk can be too big for a node per explored cell, so its search
+// keeps what a node would hold on disk as well, in arrays beside the map: g,
+// and the index into search::dirs of the step each cell was reached by. a
+// cell's entries are only meaningful once it's marked QUEUE or EXPLORED (or
+// is the start or the goal). all that stays in memory is the frontier
+constexpr uint8_t NO_PARENT = 8;
+std::unique_ptr<tiled_array<double>> tiled_cost;
+std::unique_ptr<tiled_array<uint8_t>> tiled_parent;
+// the cell's index and its weight, lightest on top
+using entry = std::pair<double, size_t>;
+std::vector<entry> frontier;
+size_t tiled_explored;
+double tiled_goal_cost;
+// the cell the last tick expanded, for display_path()
+int last_x, last_y;
+// whether the last search was of a map on disk, which get_stats() needs to
+// know after term()
+bool on_disk = false;
+
+// a scratch file beside the map, unlinked as soon as it's open so that
+// nothing is left behind
+template <typename T>
+std::unique_ptr<tiled_array<T>> scratch_for(const tiled_grid &world) {
+    std::string path = world.path() + ".XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0)
+        throw std::runtime_error("couldn't create search state beside " +
+                                 world.path());
+    close(fd);
+    std::unique_ptr<tiled_array<T>> array;
+    try {
+        array = std::make_unique<tiled_array<T>>(
+            path, world.height(), world.width(), world.cache_tiles());
+    } catch (const std::runtime_error &) {
+        std::filesystem::remove(path);
+        throw;
+    }
+    std::filesystem::remove(path);
+    return array;
+}
+
+void drop_scratch() {
+    // nobody will read the search state again, so it isn't written back
+    if (tiled_cost)
+        tiled_cost->discard();
+    if (tiled_parent)
+        tiled_parent->discard();
+    tiled_cost.reset();
+    tiled_parent.reset();
+}
 
 bool are_diagonally_connected(const node &a, const node &b) {
     // hehehe
@@ -94,29 +174,125 @@ size_t explore_path_length;
 // it's a queue. sshhhh
 std::vector<node> queue;
 std::list<node> visited;
+// the cells display_path() painted, to be unpainted before the next one
+std::vector<std::pair<int, int>> explore_path;
 
-inline bool between(int val, int low, int high) {
-    return val >= low && val < high;
+void clear_explore_path() {
+    for (auto [x, y] : explore_path) {
+        if (cell(x, y) == EXPLORE_PATH)
+            set_cell(x, y, EXPLORED);
+    }
+    explore_path.clear();
+}
+
+// node::compute_weight()'s h, for the search on disk, which has no nodes
+inline double heuristic(int x, int y) {
+    int dx = std::abs(x - goal.x());
+    int dy = std::abs(y - goal.y());
+    return (dx + dy) - search::SQRT2 * std::min(dx, dy);
+}
+
+// follows the parents on disk from (x, y) back to the start, calling
+// visit(x, y, step) on each cell with the step that led to it
+template <typename F> void walk_tiled(int x, int y, F visit) {
+    while (true) {
+        uint8_t step = tiled_parent->get(x, y);
+        visit(x, y, step);
+        if (step == NO_PARENT)
+            return;
+        x -= search::dirs[step].first;
+        y -= search::dirs[step].second;
+    }
 }
 
 void display_path() {
     // display the current path
     explore_path_length = 0;
-    node *cur = &visited.front();
-    while (cur != nullptr) {
-        int &grid_square = (*current_grid)[cur->y()][cur->x()];
-        if (grid_square == EXPLORED)
+    auto show = [](int x, int y) {
+        if (cell(x, y) == EXPLORED) {
             // grid_square = EXPLORE_PATH;
-            render::update(cur->x(), cur->y(), EXPLORE_PATH);
+            set_cell(x, y, EXPLORE_PATH);
+            explore_path.emplace_back(x, y);
+        }
         explore_path_length++;
-        cur = cur->parent();
+    };
+    if (on_disk) {
+        walk_tiled(last_x, last_y, [&](int x, int y, uint8_t) { show(x, y); });
+        return;
+    }
+    for (node *cur = &visited.front(); cur != nullptr; cur = cur->parent())
+        show(cur->x(), cur->y());
+}
+
+// tick() for a map on disk: the same search, but with cells in a heap
+// instead of nodes in a sorted vector, and their g and parents on disk
+bool tick_tiled() {
+    if (frontier.empty()) {
+        success = false;
+        return true;
+    }
+
+    clear_explore_path();
+    int width = grid_width();
+    size_t idx = frontier.front().second;
+    int x = idx % width, y = idx / width;
+    tiled_explored++;
+    if (x == goal.x() && y == goal.y()) {
+        success = true;
+        return true;
+    }
+    std::pop_heap(frontier.begin(), frontier.end(), std::greater<entry>());
+    frontier.pop_back();
+    last_x = x;
+    last_y = y;
+
+    if (cell(x, y) != START)
+        set_cell(x, y, EXPLORED);
+    // read ahead in the direction the search is going, in all three arrays
+    uint8_t from = tiled_parent->get(x, y);
+    if (from != NO_PARENT) {
+        auto [dx, dy] = search::dirs[from];
+        current_tiles->prefetch(x, y, dx, dy);
+        tiled_cost->prefetch(x, y, dx, dy);
+        tiled_parent->prefetch(x, y, dx, dy);
     }
+
+    double g = tiled_cost->get(x, y);
+    for (int k = 0; k < 8; k++) {
+        int newx = x + search::dirs[k].first;
+        int newy = y + search::dirs[k].second;
+        if (!search::between(newx, 0, width) ||
+            !search::between(newy, 0, grid_height()))
+            continue;
+        int cur_square = cell(newx, newy);
+        if (cur_square != PASSABLE && cur_square != GOAL)
+            continue;
+        double cost = g + (k < 4 ? 1 : search::SQRT2);
+        if (cur_square == PASSABLE)
+            set_cell(newx, newy, QUEUE);
+        else if (cost < tiled_goal_cost)
+            // the goal is queued again for every cheaper way found to it
+            tiled_goal_cost = cost;
+        else
+            continue;
+        tiled_cost->set(newx, newy, cost);
+        tiled_parent->set(newx, newy, k);
+        frontier.emplace_back(cost + heuristic(newx, newy),
+                              search::index(newx, newy, width));
+        std::push_heap(frontier.begin(), frontier.end(),
+                       std::greater<entry>());
+    }
+    if (path_display)
+        display_path();
+    return false;
 }
 
 bool tick() {
     // sanity check for whether we're initialized
     if (!initialized)
         return false;
+    if (on_disk)
+        return tick_tiled();
     if (queue.empty()) {
         // algorithm is done when the queue is empty
         // however, the algorithm failed to find a path. :(
@@ -124,12 +300,7 @@ bool tick() {
         return true;
     }
 
-    for (size_t i = 0; i < current_grid->size(); i++) {
-        for (size_t j = 0; j < (*current_grid)[i].size(); j++) {
-            if ((*current_grid)[i][j] == EXPLORE_PATH)
-                render::update(j, i, EXPLORED);
-        }
-    }
+    clear_explore_path();
     {
         node cur = queue.back();
         if (cur.x() == goal.x() && cur.y() == goal.y()) {
@@ -142,24 +313,26 @@ bool tick() {
     }
 
     node *cur = &visited.front();
-    if ((*current_grid)[cur->y()][cur->x()] != START)
+    if (cell(cur->x(), cur->y()) != START)
         // (*current_grid)[cur->y()][cur->x()] = EXPLORED;
-        render::update(cur->x(), cur->y(), EXPLORED);
+        set_cell(cur->x(), cur->y(), EXPLORED);
+    // an on-disk map gets to read ahead in the direction the search is going
+    if (current_tiles && cur->parent())
+        current_tiles->prefetch(cur->x(), cur->y(),
+                                cur->x() - cur->parent()->x(),
+                                cur->y() - cur->parent()->y());
 
-    static const std::pair<int, int> dirs[8] = {
-        {-1, 0}, {0, -1}, {1, 0}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
-
-    for (std::pair<int, int> dir : dirs) {
+    for (std::pair<int, int> dir : search::dirs) {
         int newx = cur->x() + dir.first;
         int newy = cur->y() + dir.second;
 
-        if (between(newx, 0, current_grid->width()) &&
-            between(newy, 0, current_grid->height())) {
-            int &cur_square = (*current_grid)[newy][newx];
+        if (search::between(newx, 0, grid_width()) &&
+            search::between(newy, 0, grid_height())) {
+            int cur_square = cell(newx, newy);
             if (cur_square == PASSABLE || cur_square == GOAL) {
                 if (cur_square == PASSABLE)
                     // (*current_grid)[newy][newx] = QUEUE;
-                    render::update(newx, newy, QUEUE);
+                    set_cell(newx, newy, QUEUE);
                 queue.push_back(node(newx, newy, goal, cur));
             }
         }
@@ -170,16 +343,24 @@ bool tick() {
     return false;
 }
 
-void backtrack(grid<int> &world) {
+void backtrack() {
     // finish the algorithm by finding the final added node and going ->parent
     // repeatedly
     // assuming normal execution, the front will be the goal node. :D
+    if (on_disk) {
+        walk_tiled(goal.x(), goal.y(), [](int x, int y, uint8_t step) {
+            if (cell(x, y) == EXPLORED)
+                set_cell(x, y, PATH);
+            if (step != NO_PARENT)
+                path_length += step < 4 ? 1 : search::SQRT2;
+        });
+        return;
+    }
     node *current = &visited.front();
     while (current != nullptr) {
-        int &grid_square = world[current->y()][current->x()];
-        if (grid_square == EXPLORED)
+        if (cell(current->x(), current->y()) == EXPLORED)
             // grid_square = PATH;
-            render::update(current->x(), current->y(), PATH);
+            set_cell(current->x(), current->y(), PATH);
         if (current->parent())
             path_length +=
                 (are_diagonally_connected(*current, *current->parent())
@@ -194,27 +375,60 @@ void weights() {
     for (node n : queue) {
         note_log << n.weight() << " ";
     }
+    for (auto [weight, idx] : frontier) {
+        note_log << weight << " ";
+    }
     note_log << "\n";
 }
 
-void init(const node &_goal, const node &start, grid<int> &world) {
+void begin_search(const node &_goal) {
     path_length = 0;
     goal = _goal;
-    queue.push_back(start);
-    current_grid = &world;
     initialized = true;
     success = false;
     done = false;
 }
 
+void seed_tiled(const node &start) {
+    tiled_cost->set(start.x(), start.y(), 0);
+    tiled_parent->set(start.x(), start.y(), NO_PARENT);
+    frontier.assign(
+        1, entry{0, search::index(start.x(), start.y(), grid_width())});
+}
+
+void init(const node &_goal, const node &start, grid<int> &world) {
+    begin_search(_goal);
+    queue.push_back(start);
+    current_grid = &world;
+    current_tiles = nullptr;
+    on_disk = false;
+}
+
+void init(const node &_goal, const node &start, tiled_grid &world) {
+    begin_search(_goal);
+    current_grid = nullptr;
+    current_tiles = &world;
+    on_disk = true;
+    drop_scratch();
+    tiled_cost = scratch_for<double>(world);
+    tiled_parent = scratch_for<uint8_t>(world);
+    tiled_explored = 0;
+    tiled_goal_cost = std::numeric_limits<double>::infinity();
+    seed_tiled(start);
+}
+
 void change_goal(const node &_goal) { goal = _goal; }
 
 void change_start(const node &start) {
     // if this is called in the middle of a*, bad things will happen
-    if (queue.size() != 1)
+    if ((on_disk ? frontier.size() : queue.size()) != 1 ||
+        (on_disk && !tiled_cost))
         throw std::logic_error(
             "change_start called during invalid astar state");
-    queue[0] = start;
+    if (on_disk)
+        seed_tiled(start);
+    else
+        queue[0] = start;
 }
 
 void term() {
@@ -223,10 +437,12 @@ void term() {
 
     // aaaaaaaaaaaaaaaHHHHHHHH I had this after the current_grid = nullptr
     // *facepalm*
-    current_grid->clear(EXPLORE_PATH, EXPLORED);
+    clear_explore_path();
     if (success)
-        backtrack(*current_grid);
+        backtrack();
+    drop_scratch();
     current_grid = nullptr;
+    current_tiles = nullptr;
     goal = node(-1, -1);
     initialized = false;
     done = true;
@@ -239,11 +455,31 @@ void reset(grid<int> &world) {
     world.clear(EXPLORED, PASSABLE);
     world.clear(QUEUE, PASSABLE);
     world.clear(PATH, PASSABLE);
+    world.clear(EXPLORE_PATH, PASSABLE);
+
+    explore_path.clear();
+    explore_path_length = 0;
+}
+
+void reset(tiled_grid &world) {
+    queue.clear();
+    visited.clear();
+    frontier.clear();
+    tiled_explored = 0;
+
+    world.clear(EXPLORED, PASSABLE);
+    world.clear(QUEUE, PASSABLE);
+    world.clear(PATH, PASSABLE);
+    world.clear(EXPLORE_PATH, PASSABLE);
 
+    explore_path.clear();
     explore_path_length = 0;
 }
 
 stats get_stats() {
+    if (on_disk)
+        return stats{path_length, frontier.size(), tiled_explored,
+                     explore_path_length};
     return stats{path_length, queue.size(), visited.size(),
                  explore_path_length};
 }
@@ -1,11 +1,11 @@
 #pragma once
 #include "grid.hpp"
 
-#include "grid.hpp"
-
 #include <compare>
 #include <functional>
 
+class tiled_grid;
+
 namespace astar {
 class node {
     double _weight;
@@ -46,10 +46,14 @@ extern bool done;
 
 bool tick();
 void init(const node &_goal, const node &start, grid<int> &world);
-void backtrack(grid<int> &world);
+// searches a map on disk instead of the one on screen; its start and goal
+// cells have to be marked START and GOAL as on screen
+void init(const node &_goal, const node &start, tiled_grid &world);
+void backtrack();
 void weights();
 void term();
 void reset(grid<int> &world);
+void reset(tiled_grid &world);
 stats get_stats();
 void change_goal(const node &_goal);
 void change_start(const node &start);
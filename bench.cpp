@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <fmt/core.h>
+#include <ncurses.h>
+#include <unistd.h>
+
+#include "ara.hpp"
+#include "astar.hpp"
+#include "flow.hpp"
+#include "gen.hpp"
+#include "grid.hpp"
+#include "logs.hpp"
+#include "render.hpp"
+#include "subgoal.hpp"
+#include "theta.hpp"
+#include "tiled.hpp"
+#include "trace.hpp"
+
+// benchmarks for the engines on seeded maps. results go to stdout (or --out)
+// as csv, and can be checked against a previous run's csv with --baseline
+
+std::stringstream note_log;
+
+// small enough that the bigger maps don't fit in the cache
+constexpr size_t BENCH_CACHE_TILES = 4;
+
+struct options {
+    std::vector<int> sizes{64, 128, 256};
+    std::vector<double> fills{10, 25, 40};
+    std::vector<gen::kind> maps{gen::kind::noise, gen::kind::maze,
+                                gen::kind::rooms, gen::kind::caves};
+    uint64_t seed = 52;
+    int repeat = 3;
+    std::string out;
+    std::string baseline;
+    double threshold = 10.0;
+};
+
+struct result {
+    std::string name;
+    std::string map;
+    int width, height;
+    double fill;
+    size_t ops;
+    double ns_per_op;
+};
+
+std::vector<double> parse_list(const std::string &list) {
+    std::vector<double> values;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');)
+        values.push_back(std::atof(item.c_str()));
+    return values;
+}
+
+options parse_args(int argc, char *argv[]) {
+    options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << "\n";
+            std::exit(2);
+        }
+        std::string value = argv[++i];
+        if (arg == "--sizes") {
+            opts.sizes.clear();
+            for (double size : parse_list(value))
+                opts.sizes.push_back(static_cast<int>(size));
+        } else if (arg == "--fills") {
+            opts.fills = parse_list(value);
+        } else if (arg == "--maps") {
+            opts.maps.clear();
+            std::stringstream stream(value);
+            for (std::string item; std::getline(stream, item, ',');) {
+                std::optional<gen::kind> parsed = gen::parse(item);
+                if (!parsed) {
+                    std::cerr << "unknown generator " << item << "\n";
+                    std::exit(2);
+                }
+                opts.maps.push_back(*parsed);
+            }
+        } else if (arg == "--seed") {
+            opts.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--repeat") {
+            opts.repeat = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--out") {
+            opts.out = value;
+        } else if (arg == "--baseline") {
+            opts.baseline = value;
+        } else if (arg == "--threshold") {
+            opts.threshold = std::atof(value.c_str());
+        } else {
+            std::cerr << "unknown option " << arg << "\n"
+                      << "usage: pathfinding_bench [--sizes 64,128] "
+                         "[--fills 10,40] [--maps noise,maze,rooms,caves] "
+                         "[--seed n] [--repeat n] [--out file.csv] "
+                         "[--baseline file.csv] [--threshold pct]\n";
+            std::exit(2);
+        }
+    }
+    return opts;
+}
+
+// runs `body` (which returns how many operations it did) `repeat` times and
+// keeps the fastest, which is the least disturbed by everything else going on.
+// `setup` runs untimed before every repetition
+double best_ns_per_op(int repeat, size_t &ops,
+                      const std::function<size_t()> &body,
+                      const std::function<void()> &setup) {
+    double best = 0;
+    for (int i = 0; i < repeat; i++) {
+        if (setup)
+            setup();
+        auto begin = std::chrono::steady_clock::now();
+        ops = body();
+        double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - begin)
+                        .count();
+        double per_op = ns / std::max<size_t>(ops, 1);
+        if (i == 0 || per_op < best)
+            best = per_op;
+    }
+    return best;
+}
+
+void fresh_map(int size, double fill, uint64_t seed, gen::kind map) {
+    astar::reset(render::world);
+    ara::reset();
+    flow::reset();
+    subgoal::reset();
+    theta::reset();
+    render::init(size, size, 1, fill, seed, map);
+    // from here on cell changes queue up for the next draw, as in the tui
+    render::draw();
+}
+
+void restart_astar() {
+    astar::reset(render::world);
+    astar::init(astar::node(render::goal_x, render::goal_y),
+                astar::node(render::start_x, render::start_y), render::world);
+    render::draw();  // flush the reset so it isn't timed with the run
+}
+
+void run_map(const options &opts, int size, double fill, gen::kind map,
+             std::vector<result> &results) {
+    const std::string &map_name = gen::name(map);
+    auto record = [&](const std::string &name,
+                      const std::function<size_t()> &body,
+                      const std::function<void()> &setup = {}) {
+        size_t ops = 0;
+        double ns = best_ns_per_op(opts.repeat, ops, body, setup);
+        results.push_back(result{name, map_name, size, size, fill, ops, ns});
+    };
+    std::mt19937_64 rng(opts.seed);
+
+    grid<int> scratch(size, size);
+    record(fmt::format("gen/{}", map_name), [&] {
+        gen::generate(scratch, map, fill, opts.seed,
+                      {{1, 1}, {size - 2, size - 2}});
+        return size_t(1);
+    });
+
+    fresh_map(size, fill, opts.seed, map);
+    grid<int> &world = render::world;
+
+    // astar's open list is a vector that gets fully sorted after every
+    // expansion; the other engines use a binary heap
+    record("open_list/sorted_vector", [&] {
+        std::vector<astar::node> queue;
+        astar::node goal(render::goal_x, render::goal_y);
+        astar::node root(render::start_x, render::start_y);
+        size_t ops = 0;
+        for (int i = 0; i < size * 4; i++, ops++) {
+            for (int j = 0; j < 8; j++)
+                queue.emplace_back(rng() % size, rng() % size, goal, &root);
+            std::sort(queue.begin(), queue.end(), astar::node::rev_cmp);
+            queue.pop_back();
+        }
+        return ops;
+    });
+    record("open_list/binary_heap", [&] {
+        using entry = std::pair<double, uint32_t>;
+        std::vector<entry> heap;
+        size_t ops = 0;
+        for (int i = 0; i < size * 4; i++, ops++) {
+            for (int j = 0; j < 8; j++) {
+                heap.emplace_back(static_cast<double>(rng() % 10000), j);
+                std::push_heap(heap.begin(), heap.end(), std::greater<entry>());
+            }
+            std::pop_heap(heap.begin(), heap.end(), std::greater<entry>());
+            heap.pop_back();
+        }
+        return ops;
+    });
+
+    // one tick is one expansion: neighbour generation plus the bookkeeping
+    // around it. a full query is the same run, so it isn't timed twice
+    record(
+        "astar/tick",
+        [&] {
+            size_t ticks = 1;
+            while (!astar::tick())
+                ticks++;
+            astar::term();
+            return ticks;
+        },
+        restart_astar);
+    results.push_back(result{"astar/query", map_name, size, size, fill, 1,
+                             results.back().ns_per_op * results.back().ops});
+    // and again with every cell change traced, which should cost little
+    // enough to leave on
+    record(
+        "astar/tick_traced",
+        [&] {
+            size_t ticks = 1;
+            tracer::start("/dev/null", world);
+            while (!astar::tick())
+                ticks++;
+            astar::term();
+            tracer::stop();
+            return ticks;
+        },
+        restart_astar);
+    astar::reset(world);
+    render::draw();
+
+    // the same search once more, on a copy of the map kept on disk
+    {
+        // a name of its own, so that benches running side by side don't
+        // share a map
+        std::string path = (std::filesystem::temp_directory_path() /
+                            "pathfinding_bench.XXXXXX")
+                               .string();
+        int fd = mkstemp(path.data());
+        if (fd < 0) {
+            std::cerr << "couldn't create a temporary tiled map\n";
+            std::exit(1);
+        }
+        close(fd);
+        tiled_grid tiles(path, size, size, BENCH_CACHE_TILES);
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++)
+                tiles.set(x, y, world[y][x]);
+        }
+        // what the cache did during the last run, to go with its timing
+        tiled_grid::stats before{}, after{};
+        record(
+            "tiled/astar_tick",
+            [&] {
+                before = tiles.get_stats();
+                size_t ticks = 1;
+                while (!astar::tick())
+                    ticks++;
+                astar::term();
+                after = tiles.get_stats();
+                return ticks;
+            },
+            [&] {
+                astar::reset(tiles);
+                astar::init(astar::node(render::goal_x, render::goal_y),
+                            astar::node(render::start_x, render::start_y),
+                            tiles);
+            });
+        std::cerr << fmt::format(
+            "tiled {} {}x{} fill {}: {} hits, {} misses ({} prefetched), {} "
+            "evictions, {} bytes read, {} bytes written\n",
+            map_name, size, size, fill, after.hits - before.hits,
+            after.misses - before.misses,
+            after.prefetch_hits - before.prefetch_hits,
+            after.evictions - before.evictions,
+            after.bytes_read - before.bytes_read,
+            after.bytes_written - before.bytes_written);
+        astar::reset(tiles);
+        std::filesystem::remove(path);
+    }
+
+    record("flow/uniform", [&] {
+        flow::compute(world, render::goal_x, render::goal_y,
+                      flow::cost::uniform);
+        return size_t(1);
+    });
+    record("flow/octile", [&] {
+        flow::compute(world, render::goal_x, render::goal_y);
+        return size_t(1);
+    });
+    record("flow/follow", [&] {
+        return flow::follow(render::start_x, render::start_y).size();
+    });
+
+    record("subgoal/preprocess", [&] {
+        subgoal::build(world);
+        return size_t(1);
+    });
+    record("subgoal/query", [&] {
+        subgoal::query(render::start_x, render::start_y, render::goal_x,
+                       render::goal_y);
+        return size_t(1);
+    });
+
+    record("ara/query", [&] {
+        ara::init(world, render::start_x, render::start_y, render::goal_x,
+                  render::goal_y);
+        ara::improve(std::chrono::steady_clock::time_point::max());
+        return size_t(1);
+    });
+
+    record("theta/lazy", [&] {
+        theta::query(world, render::start_x, render::start_y, render::goal_x,
+                     render::goal_y);
+        return size_t(1);
+    });
+    record("theta/los", [&] {
+        for (int i = 0; i < 10000; i++)
+            theta::line_of_sight(rng() % size, rng() % size, rng() % size,
+                                 rng() % size);
+        return size_t(10000);
+    });
+
+    // a frame's worth of cell changes followed by the draw that flushes them
+    for (int batch : {64, 4096}) {
+        render::draw();  // first draw is a full redraw
+        record(fmt::format("render/updates_{}", batch), [&] {
+            for (int i = 0; i < batch; i++) {
+                int x = rng() % size, y = rng() % size;
+                if (world[y][x] == PASSABLE || world[y][x] == EXPLORED)
+                    render::update(x, y,
+                                   world[y][x] == PASSABLE ? EXPLORED
+                                                           : PASSABLE);
+            }
+            render::draw();
+            return size_t(1);
+        });
+    }
+}
+
+std::string to_csv(const std::vector<result> &results) {
+    std::string csv = "benchmark,map,width,height,fill,ops,ns_per_op\n";
+    for (const result &res : results)
+        csv += fmt::format("{},{},{},{},{},{},{:.1f}\n", res.name, res.map,
+                           res.width, res.height, res.fill, res.ops,
+                           res.ns_per_op);
+    return csv;
+}
+
+using result_key = std::tuple<std::string, std::string, int, int, double>;
+
+std::map<result_key, double> read_csv(const std::string &path) {
+    std::map<result_key, double> timings;
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);  // header
+    while (std::getline(in, line)) {
+        std::stringstream fields(line);
+        std::string name, map, width, height, fill, ops, ns;
+        if (std::getline(fields, name, ',') && std::getline(fields, map, ',') &&
+            std::getline(fields, width, ',') &&
+            std::getline(fields, height, ',') &&
+            std::getline(fields, fill, ',') && std::getline(fields, ops, ',') &&
+            std::getline(fields, ns, ','))
+            timings[{name, map, std::atoi(width.c_str()),
+                     std::atoi(height.c_str()), std::atof(fill.c_str())}] =
+                std::atof(ns.c_str());
+    }
+    return timings;
+}
+
+// prints every benchmark that got slower than the baseline by more than the
+// threshold; returns how many did
+int compare(const std::vector<result> &results, const options &opts) {
+    std::map<result_key, double> baseline = read_csv(opts.baseline);
+    if (baseline.empty()) {
+        std::cerr << "no baseline results in " << opts.baseline << "\n";
+        return 0;
+    }
+    int regressions = 0;
+    for (const result &res : results) {
+        auto found = baseline.find(
+            {res.name, res.map, res.width, res.height, res.fill});
+        if (found == baseline.end() || found->second <= 0)
+            continue;
+        double change = (res.ns_per_op / found->second - 1) * 100;
+        if (change > opts.threshold) {
+            regressions++;
+            std::cerr << fmt::format(
+                "regression: {} on {} {}x{} fill {}: {:.1f}ns -> {:.1f}ns "
+                "(+{:.1f}%)\n",
+                res.name, res.map, res.width, res.height, res.fill,
+                found->second,
+                res.ns_per_op, change);
+        }
+    }
+    std::cerr << fmt::format("{} regression(s) beyond {}%\n", regressions,
+                             opts.threshold);
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    options opts = parse_args(argc, argv);
+
+    // rendering is measured against a real curses screen that writes to
+    // /dev/null, sized so that the largest map fits
+    int largest = *std::max_element(opts.sizes.begin(), opts.sizes.end());
+    setenv("LINES", std::to_string(largest + STATUS_LINES).c_str(), 1);
+    setenv("COLUMNS", std::to_string(std::max(largest, 120)).c_str(), 1);
+    if (!std::getenv("TERM"))
+        setenv("TERM", "xterm", 1);
+    FILE *sink = std::fopen("/dev/null", "w");
+    SCREEN *screen = newterm(nullptr, sink, stdin);
+    if (!screen) {
+        std::cerr << "couldn't set up a curses screen\n";
+        return 2;
+    }
+
+    std::vector<result> results;
+    for (int size : opts.sizes) {
+        for (gen::kind map : opts.maps) {
+            // mazes and rooms don't have a fill rate, so they only need the
+            // one run per size
+            bool filled = map == gen::kind::noise || map == gen::kind::caves;
+            for (double fill : opts.fills) {
+                run_map(opts, size, filled ? fill : 0, map, results);
+                if (!filled)
+                    break;
+            }
+        }
+    }
+
+    endwin();
+    delscreen(screen);
+    std::fclose(sink);
+
+    std::string csv = to_csv(results);
+    if (opts.out.empty()) {
+        std::cout << csv;
+    } else {
+        std::ofstream(opts.out) << csv;
+    }
+    if (!opts.baseline.empty() && compare(results, opts) > 0)
+        return 1;
+}
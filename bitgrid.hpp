@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// one bit per cell, with every row padded out to whole 64-bit words so that
+// runs of cells can be tested or combined with a single word operation
+class bitgrid {
+    std::vector<uint64_t> data;
+    size_t _height, _width, _words;
+
+ public:
+    bitgrid(size_t height = 0, size_t width = 0)
+        : _height(height), _width(width), _words((width + 63) / 64) {
+        data = std::vector<uint64_t>(_height * _words);
+    }
+
+    inline bool get(size_t x, size_t y) const {
+        return (data[y * _words + x / 64] >> (x % 64)) & 1;
+    }
+
+    inline void set(size_t x, size_t y, bool val) {
+        uint64_t &word = data[y * _words + x / 64];
+        uint64_t bit = uint64_t(1) << (x % 64);
+        word = val ? (word | bit) : (word & ~bit);
+    }
+
+    inline uint64_t *row(size_t y) { return &data[y * _words]; }
+    inline const uint64_t *row(size_t y) const { return &data[y * _words]; }
+
+    inline size_t height() const { return _height; }
+    inline size_t width() const { return _width; }
+    // words per row
+    inline size_t words() const { return _words; }
+
+    void fill(bool val) {
+        std::fill(data.begin(), data.end(), val ? ~uint64_t(0) : 0);
+        if (!val || _width % 64 == 0)
+            return;
+        // keep the padding past the last column clear
+        for (size_t y = 0; y < _height; y++)
+            row(y)[_words - 1] &= (uint64_t(1) << (_width % 64)) - 1;
+    }
+
+    // true if every bit in [lo, hi] of row y is set
+    bool all(size_t y, size_t lo, size_t hi) const {
+        const uint64_t *words = row(y);
+        size_t first = lo / 64, last = hi / 64;
+        uint64_t lo_mask = ~uint64_t(0) << (lo % 64);
+        uint64_t hi_mask = ~uint64_t(0) >> (63 - hi % 64);
+        if (first == last)
+            return (~words[first] & lo_mask & hi_mask) == 0;
+        if (~words[first] & lo_mask)
+            return false;
+        for (size_t i = first + 1; i < last; i++) {
+            if (~words[i])
+                return false;
+        }
+        return (~words[last] & hi_mask) == 0;
+    }
+
+    size_t count() const {
+        size_t total = 0;
+        for (uint64_t word : data)
+            total += std::popcount(word);
+        return total;
+    }
+};
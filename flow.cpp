@@ -0,0 +1,356 @@
+#include "flow.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "bitgrid.hpp"
+#include "grid.hpp"
+#include "render.hpp"
+#include "search.hpp"
+
+namespace flow {
+using search::between;
+using search::dirs;
+using search::index;
+
+constexpr uint32_t UNREACHED = std::numeric_limits<uint32_t>::max();
+constexpr uint8_t NO_DIR = 8;
+
+// edge costs are scaled to integers so the octile field can use a bucket
+// queue; 577/408 is within 2e-6 of sqrt(2)
+constexpr uint32_t STRAIGHT_COST = 408;
+constexpr uint32_t DIAGONAL_COST = 577;
+
+const char arrows[NO_DIR + 1] = {'<', '^', '>', 'v', '\\', '/', '/', '\\', ' '};
+
+grid<int> *current_grid = nullptr;
+cost current_cost = cost::octile;
+int width = 0, height = 0;
+int goal_x = -1, goal_y = -1;
+
+bitgrid open;
+std::vector<uint32_t> dist;
+std::vector<uint8_t> dir;
+
+bool computed = false;
+bool field_display = false;
+
+stats last_stats{};
+
+inline uint32_t step_cost(int k) {
+    if (current_cost == cost::uniform)
+        return 1;
+    return k < 4 ? STRAIGHT_COST : DIAGONAL_COST;
+}
+
+inline uint8_t opposite(int k) { return k < 4 ? (k + 2) % 4 : 11 - k; }
+
+// dial's algorithm: every pending distance is within one edge cost of the
+// one being settled, so a ring of DIAGONAL_COST + 1 buckets covers them all
+class bucket_queue {
+    std::vector<std::vector<uint32_t>> buckets;
+    uint32_t cur = 0;
+    size_t count = 0;
+
+ public:
+    bucket_queue() : buckets(DIAGONAL_COST + 1) {}
+
+    inline bool empty() const { return count == 0; }
+
+    inline void push(uint32_t idx, uint32_t d) {
+        buckets[d % buckets.size()].push_back(idx);
+        count++;
+    }
+
+    std::pair<uint32_t, uint32_t> pop() {
+        while (buckets[cur % buckets.size()].empty())
+            cur++;
+        std::vector<uint32_t> &bucket = buckets[cur % buckets.size()];
+        uint32_t idx = bucket.back();
+        bucket.pop_back();
+        count--;
+        return {idx, cur};
+    }
+};
+
+// repairs start from seeds that can be arbitrarily far apart, which the ring
+// of buckets can't hold, so they go through a plain binary heap instead
+class heap_queue {
+    using entry = std::pair<uint32_t, uint32_t>;  // distance, index
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry>> heap;
+
+ public:
+    inline bool empty() const { return heap.empty(); }
+    inline void push(uint32_t idx, uint32_t d) { heap.emplace(d, idx); }
+
+    std::pair<uint32_t, uint32_t> pop() {
+        entry top = heap.top();
+        heap.pop();
+        return {top.second, top.first};
+    }
+};
+
+inline void settle(size_t idx, uint32_t d, uint8_t k) {
+    if (dist[idx] == UNREACHED)
+        last_stats.reachable++;
+    dist[idx] = d;
+    dir[idx] = k;
+}
+
+template <typename queue> size_t propagate(queue &pending) {
+    size_t settled = 0;
+    while (!pending.empty()) {
+        auto [u, d] = pending.pop();
+        if (d != dist[u])
+            continue;  // superseded by a shorter route
+        settled++;
+        int ux = u % width, uy = u / width;
+        for (int k = 0; k < 8; k++) {
+            int vx = ux + dirs[k].first;
+            int vy = uy + dirs[k].second;
+            if (!between(vx, 0, width) || !between(vy, 0, height) ||
+                !open.get(vx, vy))
+                continue;
+            size_t v = index(vx, vy, width);
+            uint32_t new_dist = d + step_cost(k);
+            if (new_dist < dist[v]) {
+                settle(v, new_dist, opposite(k));
+                pending.push(v, new_dist);
+            }
+        }
+    }
+    return settled;
+}
+
+// splits the rows into one band per hardware thread
+void parallel_rows(const std::function<void(int, int)> &fn) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    // thread startup costs more than small maps take to do serially
+    if (static_cast<size_t>(width) * height < (1 << 16))
+        threads = 1;
+    int band = (height + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (int lo = 0; lo < height; lo += band)
+        workers.emplace_back(fn, lo, std::min(height, lo + band));
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void wavefront() {
+    // each wave dilates the frontier by one cell in all 8 directions, 64 cells
+    // per word operation, and keeps only open cells that haven't been reached
+    size_t words = open.words();
+    bitgrid frontier(height, width), next(height, width), seen(height, width);
+    frontier.set(goal_x, goal_y, true);
+    seen.set(goal_x, goal_y, true);
+
+    // rows of `frontier` outside [lo, hi] hold stale waves and are never read
+    int lo = goal_y, hi = goal_y;
+    for (uint32_t d = 1; lo <= hi; d++) {
+        auto column = [&](int r, size_t i) -> uint64_t {
+            uint64_t word = 0;
+            for (int row = r - 1; row <= r + 1; row++) {
+                if (row >= lo && row <= hi)
+                    word |= frontier.row(row)[i];
+            }
+            return word;
+        };
+
+        int next_lo = height, next_hi = -1;
+        int first = std::max(lo - 1, 0), last = std::min(hi + 1, height - 1);
+        for (int r = first; r <= last; r++) {
+            const uint64_t *passable = open.row(r);
+            uint64_t *visited = seen.row(r);
+            uint64_t *out = next.row(r);
+            uint64_t prev = 0, cur = column(r, 0);
+            bool any = false;
+            for (size_t i = 0; i < words; i++) {
+                uint64_t after = i + 1 < words ? column(r, i + 1) : 0;
+                uint64_t grown = cur | (cur << 1) | (prev >> 63) | (cur >> 1) |
+                                 (after << 63);
+                uint64_t reached = grown & passable[i] & ~visited[i];
+                out[i] = reached;
+                if (reached) {
+                    any = true;
+                    visited[i] |= reached;
+                    size_t base = index(i * 64, r, width);
+                    for (uint64_t bits = reached; bits; bits &= bits - 1)
+                        dist[base + std::countr_zero(bits)] = d;
+                }
+                prev = cur;
+                cur = after;
+            }
+            if (any) {
+                next_lo = std::min(next_lo, r);
+                next_hi = r;
+            }
+        }
+        std::swap(frontier, next);
+        lo = next_lo;
+        hi = next_hi;
+    }
+
+    // with every distance known, each cell's direction only depends on its
+    // neighbours, so the rows can be split between threads
+    parallel_rows([](int row_lo, int row_hi) {
+        for (int y = row_lo; y < row_hi; y++) {
+            for (int x = 0; x < width; x++) {
+                size_t u = index(x, y, width);
+                if (dist[u] == UNREACHED || dist[u] == 0)
+                    continue;
+                for (int k = 0; k < 8; k++) {
+                    int nx = x + dirs[k].first;
+                    int ny = y + dirs[k].second;
+                    if (between(nx, 0, width) && between(ny, 0, height) &&
+                        dist[index(nx, ny, width)] == dist[u] - 1) {
+                        dir[u] = k;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+    last_stats.reachable = seen.count();
+}
+
+void compute(grid<int> &world, int _goal_x, int _goal_y, cost mode) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    current_grid = &world;
+    current_cost = mode;
+    width = world.width();
+    height = world.height();
+    goal_x = _goal_x;
+    goal_y = _goal_y;
+    last_stats = stats{};
+
+    open = bitgrid(height, width);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++)
+            open.set(x, y, world[y][x] != IMPASSABLE);
+    }
+    dist.assign(static_cast<size_t>(width) * height, UNREACHED);
+    dir.assign(static_cast<size_t>(width) * height, NO_DIR);
+
+    if (open.get(goal_x, goal_y)) {
+        if (mode == cost::uniform) {
+            dist[index(goal_x, goal_y, width)] = 0;
+            wavefront();
+        } else {
+            settle(index(goal_x, goal_y, width), 0, NO_DIR);
+            bucket_queue pending;
+            pending.push(index(goal_x, goal_y, width), 0);
+            propagate(pending);
+        }
+    }
+
+    last_stats.compute_us = search::elapsed_us(begin);
+    computed = true;
+}
+
+void relax_from_neighbours(int x, int y, heap_queue &pending) {
+    size_t u = index(x, y, width);
+    for (int k = 0; k < 8; k++) {
+        int nx = x + dirs[k].first;
+        int ny = y + dirs[k].second;
+        if (!between(nx, 0, width) || !between(ny, 0, height))
+            continue;
+        size_t n = index(nx, ny, width);
+        if (dist[n] != UNREACHED && dist[n] + step_cost(k) < dist[u])
+            settle(u, dist[n] + step_cost(k), k);
+    }
+    if (dist[u] != UNREACHED)
+        pending.push(u, dist[u]);
+}
+
+void cell_changed(int x, int y) {
+    if (!computed)
+        return;
+    bool now_open = (*current_grid)[y][x] != IMPASSABLE;
+    if (now_open == open.get(x, y))
+        return;  // only passability matters to the field
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    open.set(x, y, now_open);
+    heap_queue pending;
+    if (now_open) {
+        relax_from_neighbours(x, y, pending);
+    } else {
+        // everything that used to route through the new obstacle is orphaned
+        // and gets re-derived from the cells bordering it
+        std::vector<std::pair<int, int>> orphans{{x, y}};
+        for (size_t i = 0; i < orphans.size(); i++) {
+            auto [ox, oy] = orphans[i];
+            size_t o = index(ox, oy, width);
+            if (dist[o] != UNREACHED)
+                last_stats.reachable--;
+            dist[o] = UNREACHED;
+            dir[o] = NO_DIR;
+            for (int k = 0; k < 8; k++) {
+                int nx = ox + dirs[k].first;
+                int ny = oy + dirs[k].second;
+                if (between(nx, 0, width) && between(ny, 0, height) &&
+                    dir[index(nx, ny, width)] == opposite(k)) {
+                    dir[index(nx, ny, width)] = NO_DIR;
+                    orphans.emplace_back(nx, ny);
+                }
+            }
+        }
+        for (auto [ox, oy] : orphans) {
+            if (open.get(ox, oy))
+                relax_from_neighbours(ox, oy, pending);
+        }
+    }
+    last_stats.repaired = propagate(pending);
+    last_stats.repair_us = search::elapsed_us(begin);
+}
+
+std::vector<std::pair<int, int>> follow(int x, int y) {
+    std::vector<std::pair<int, int>> path;
+    if (!computed || !between(x, 0, width) || !between(y, 0, height) ||
+        dist[index(x, y, width)] == UNREACHED)
+        return path;
+
+    // distances strictly decrease along the arrows, so this always ends at
+    // the goal
+    last_stats.path_length = 0;
+    path.emplace_back(x, y);
+    for (uint8_t k = dir[index(x, y, width)]; k != NO_DIR;
+         k = dir[index(x, y, width)]) {
+        x += dirs[k].first;
+        y += dirs[k].second;
+        last_stats.path_length += k < 4 ? 1 : search::SQRT2;
+        path.emplace_back(x, y);
+    }
+    return path;
+}
+
+double distance(int x, int y) {
+    if (!computed || dist[index(x, y, width)] == UNREACHED)
+        return std::numeric_limits<double>::infinity();
+    if (current_cost == cost::uniform)
+        return dist[index(x, y, width)];
+    return static_cast<double>(dist[index(x, y, width)]) / STRAIGHT_COST;
+}
+
+char arrow(int x, int y) {
+    if (!computed)
+        return ' ';
+    return arrows[dir[index(x, y, width)]];
+}
+
+void reset() {
+    computed = false;
+    current_grid = nullptr;
+    last_stats = stats{};
+}
+
+stats get_stats() { return last_stats; }
+}  // namespace flow
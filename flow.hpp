@@ -0,0 +1,39 @@
+#pragma once
+
+#include "grid.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace flow {
+// goal-rooted flow field: every cell knows its distance to the goal and which
+// way to step next, so any number of starts can walk to the same goal without
+// running a search of their own
+
+enum class cost {
+    // every move costs 1; built with a bit-parallel wavefront
+    uniform,
+    // same costs as astar (1 and sqrt(2)); built with a bucket queue
+    octile,
+};
+
+struct stats {
+    size_t reachable;
+    double compute_us;
+    size_t repaired;
+    double repair_us;
+    double path_length;
+};
+
+extern bool computed;
+extern bool field_display;
+
+void compute(grid<int> &world, int goal_x, int goal_y,
+             cost mode = cost::octile);
+void cell_changed(int x, int y);
+std::vector<std::pair<int, int>> follow(int x, int y);
+double distance(int x, int y);
+char arrow(int x, int y);
+void reset();
+stats get_stats();
+}  // namespace flow
@@ -0,0 +1,355 @@
+#include "gen.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <pcg_random.hpp>
+
+#include "bitgrid.hpp"
+#include "grid.hpp"
+#include "render.hpp"
+#include "tiled.hpp"
+
+namespace gen {
+// rows per band of work; fixed so that band i always draws from pcg stream i
+// no matter how many threads there are
+constexpr int BAND_ROWS = 64;
+// noise probabilities are quantized to this many bits
+constexpr int CHANCE_BITS = 16;
+constexpr int CAVE_STEPS = 4;
+
+const std::vector<std::pair<kind, std::string>> names{
+    {kind::noise, "noise"},
+    {kind::maze, "maze"},
+    {kind::rooms, "rooms"},
+    {kind::caves, "caves"}};
+
+std::optional<kind> parse(const std::string &name) {
+    for (const auto &[type, type_name] : names) {
+        if (type_name == name)
+            return type;
+    }
+    return std::nullopt;
+}
+
+const std::string &name(kind type) {
+    for (const auto &[other, type_name] : names) {
+        if (other == type)
+            return type_name;
+    }
+    return names.front().second;
+}
+
+kind next(kind type) {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i].first == type)
+            return names[(i + 1) % names.size()].first;
+    }
+    return kind::noise;
+}
+
+// hands the bands of rows out to the hardware threads
+void parallel_bands(int height, const std::function<void(int, int, int)> &fn) {
+    int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    int threads = std::min<int>(
+        bands, std::max(1u, std::thread::hardware_concurrency()));
+    auto work = [&](int first) {
+        for (int band = first; band < bands; band += threads)
+            fn(band, band * BAND_ROWS,
+               std::min(height, (band + 1) * BAND_ROWS));
+    };
+    if (threads <= 1) {
+        work(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(work, i);
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+inline int below(pcg64 &rng, int bound) {
+    return static_cast<int>(rng() % static_cast<uint64_t>(bound));
+}
+
+// fills rows [lo, hi) of `walls` with band `band` of the noise
+void noise_band(bitgrid &walls, int band, int lo, int hi, double chance,
+                uint64_t seed) {
+    // bit-sliced bernoulli: walking the bits of the probability from least to
+    // most significant, OR in a random word for every 1 and AND one in for
+    // every 0. each of the 64 lanes then ends up set with exactly that
+    // probability, for one draw per significant bit of it instead of one per
+    // cell
+    uint64_t threshold = static_cast<uint64_t>(
+        std::clamp(chance / 100, 0.0, 1.0) * (1 << CHANCE_BITS) + 0.5);
+    uint64_t padding = walls.width() % 64 == 0
+                           ? ~uint64_t(0)
+                           : (uint64_t(1) << (walls.width() % 64)) - 1;
+    pcg64 rng(seed, band);
+    for (int y = lo; y < hi; y++) {
+        uint64_t *row = walls.row(y);
+        for (size_t i = 0; i < walls.words(); i++) {
+            uint64_t word = 0;
+            if (threshold >= (1 << CHANCE_BITS)) {
+                word = ~uint64_t(0);
+            } else if (threshold > 0) {
+                for (int bit = std::countr_zero(threshold); bit < CHANCE_BITS;
+                     bit++)
+                    word = (threshold >> bit) & 1 ? word | rng() : word & rng();
+            }
+            row[i] = i + 1 == walls.words() ? word & padding : word;
+        }
+    }
+}
+
+void noise(bitgrid &walls, double chance, uint64_t seed) {
+    parallel_bands(walls.height(), [&](int band, int lo, int hi) {
+        noise_band(walls, band, lo, hi, chance, seed);
+    });
+}
+
+void maze(bitgrid &walls, uint64_t seed) {
+    // walls go on odd rows/columns and their single gap on an even one, so
+    // every wall is a solid line that meets the walls around it; chambers are
+    // kept on an explicit stack because lopsided splits can nest deeply
+    pcg64 rng(seed);
+    struct chamber {
+        int x0, y0, x1, y1;
+    };
+    std::vector<chamber> pending{
+        {0, 0, static_cast<int>(walls.width()) - 1,
+         static_cast<int>(walls.height()) - 1}};
+    while (!pending.empty()) {
+        auto [x0, y0, x1, y1] = pending.back();
+        pending.pop_back();
+        int w = x1 - x0 + 1, h = y1 - y0 + 1;
+        if (w < 3 || h < 3)
+            continue;
+        bool horizontal = h > w || (h == w && rng() % 2);
+        if (horizontal) {
+            int wall = y0 + 1 + 2 * below(rng, (h - 1) / 2);
+            int gap = x0 + 2 * below(rng, (w + 1) / 2);
+            for (int x = x0; x <= x1; x++)
+                walls.set(x, wall, x != gap);
+            pending.push_back({x0, y0, x1, wall - 1});
+            pending.push_back({x0, wall + 1, x1, y1});
+        } else {
+            int wall = x0 + 1 + 2 * below(rng, (w - 1) / 2);
+            int gap = y0 + 2 * below(rng, (h + 1) / 2);
+            for (int y = y0; y <= y1; y++)
+                walls.set(wall, y, y != gap);
+            pending.push_back({x0, y0, wall - 1, y1});
+            pending.push_back({wall + 1, y0, x1, y1});
+        }
+    }
+}
+
+void carve(bitgrid &walls, int x0, int y0, int x1, int y1) {
+    for (int y = std::min(y0, y1); y <= std::max(y0, y1); y++) {
+        for (int x = std::min(x0, x1); x <= std::max(x0, x1); x++)
+            walls.set(x, y, false);
+    }
+}
+
+void rooms(bitgrid &walls, uint64_t seed,
+           const std::vector<std::pair<int, int>> &anchors) {
+    pcg64 rng(seed);
+    int width = walls.width(), height = walls.height();
+    walls.fill(true);
+
+    struct room {
+        int x0, y0, x1, y1;
+    };
+    // anchors are 1x1 rooms so the corridors pass through them
+    std::vector<room> placed;
+    for (auto [x, y] : anchors)
+        placed.push_back({x, y, x, y});
+    int attempts = std::max(8, width * height / 200);
+    for (int i = 0; i < attempts; i++) {
+        int w = 3 + below(rng, 8), h = 3 + below(rng, 6);
+        if (w + 2 > width || h + 2 > height)
+            continue;
+        int x0 = 1 + below(rng, width - w - 1);
+        int y0 = 1 + below(rng, height - h - 1);
+        room candidate{x0, y0, x0 + w - 1, y0 + h - 1};
+        // keep at least one wall cell between rooms
+        bool overlaps = std::any_of(
+            placed.begin(), placed.end(), [&](const room &other) {
+                return candidate.x0 <= other.x1 + 1 &&
+                       other.x0 <= candidate.x1 + 1 &&
+                       candidate.y0 <= other.y1 + 1 &&
+                       other.y0 <= candidate.y1 + 1;
+            });
+        if (!overlaps)
+            placed.push_back(candidate);
+    }
+
+    // joining the rooms in order of their centres keeps corridors short; every
+    // room ends up connected to the one before it
+    std::sort(placed.begin(), placed.end(), [](const room &a, const room &b) {
+        return a.x0 + a.x1 < b.x0 + b.x1;
+    });
+    for (size_t i = 0; i < placed.size(); i++) {
+        const room &cur = placed[i];
+        carve(walls, cur.x0, cur.y0, cur.x1, cur.y1);
+        if (i == 0)
+            continue;
+        const room &prev = placed[i - 1];
+        int ax = (prev.x0 + prev.x1) / 2, ay = (prev.y0 + prev.y1) / 2;
+        int bx = (cur.x0 + cur.x1) / 2, by = (cur.y0 + cur.y1) / 2;
+        if (rng() % 2) {
+            carve(walls, ax, ay, bx, ay);
+            carve(walls, bx, ay, bx, by);
+        } else {
+            carve(walls, ax, ay, ax, by);
+            carve(walls, ax, by, bx, by);
+        }
+    }
+}
+
+// whether b can be reached from a through open cells
+bool linked(const bitgrid &walls, std::pair<int, int> a,
+            std::pair<int, int> b) {
+    int width = walls.width(), height = walls.height();
+    bitgrid seen(height, width);
+    std::vector<std::pair<int, int>> pending{a};
+    seen.set(a.first, a.second, true);
+    while (!pending.empty()) {
+        auto [x, y] = pending.back();
+        pending.pop_back();
+        if (std::pair{x, y} == b)
+            return true;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = x + dx, ny = y + dy;
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height ||
+                    walls.get(nx, ny) || seen.get(nx, ny))
+                    continue;
+                seen.set(nx, ny, true);
+                pending.emplace_back(nx, ny);
+            }
+        }
+    }
+    return false;
+}
+
+void caves(bitgrid &walls, double chance, uint64_t seed,
+           const std::vector<std::pair<int, int>> &anchors) {
+    // start from noise, then repeatedly turn every cell into rock if most of
+    // its neighbourhood is rock (the map's edge counts as rock)
+    noise(walls, chance, seed);
+    int width = walls.width(), height = walls.height();
+    bitgrid next(height, width);
+    for (int step = 0; step < CAVE_STEPS; step++) {
+        parallel_bands(height, [&](int, int lo, int hi) {
+            for (int y = lo; y < hi; y++) {
+                for (int x = 0; x < width; x++) {
+                    int rock = 0;
+                    for (int dy = -1; dy <= 1; dy++) {
+                        for (int dx = -1; dx <= 1; dx++) {
+                            int nx = x + dx, ny = y + dy;
+                            rock += nx < 0 || ny < 0 || nx >= width ||
+                                    ny >= height || walls.get(nx, ny);
+                        }
+                    }
+                    next.set(x, y, rock >= 5);
+                }
+            }
+        });
+        std::swap(walls, next);
+    }
+
+    // give the anchors a little clearing, and tunnel through to the first one
+    // from any that ended up in a different cave
+    for (auto [x, y] : anchors)
+        carve(walls, std::max(x - 1, 0), std::max(y - 1, 0),
+              std::min(x + 1, width - 1), std::min(y + 1, height - 1));
+    for (size_t i = 1; i < anchors.size(); i++) {
+        if (linked(walls, anchors[0], anchors[i]))
+            continue;
+        auto [ax, ay] = anchors[0];
+        auto [bx, by] = anchors[i];
+        carve(walls, ax, ay, bx, ay);
+        carve(walls, bx, ay, bx, by);
+    }
+}
+
+bitgrid walls_for(kind type, int height, int width, double chance,
+                  uint64_t seed,
+                  const std::vector<std::pair<int, int>> &anchors) {
+    bitgrid walls(height, width);
+    switch (type) {
+    case kind::noise:
+        noise(walls, chance, seed);
+        break;
+    case kind::maze:
+        maze(walls, seed);
+        break;
+    case kind::rooms:
+        rooms(walls, seed, anchors);
+        break;
+    case kind::caves:
+        caves(walls, chance, seed, anchors);
+        break;
+    }
+    for (auto [x, y] : anchors)
+        walls.set(x, y, false);
+    return walls;
+}
+
+void generate(grid<int> &world, kind type, double chance, uint64_t seed,
+              const std::vector<std::pair<int, int>> &anchors) {
+    int width = world.width(), height = world.height();
+    bitgrid walls = walls_for(type, height, width, chance, seed, anchors);
+    parallel_bands(height, [&](int, int lo, int hi) {
+        for (int y = lo; y < hi; y++) {
+            for (int x = 0; x < width; x++) {
+                int &cell = world[y][x];
+                if (cell == PASSABLE || cell == IMPASSABLE)
+                    cell = walls.get(x, y) ? IMPASSABLE : PASSABLE;
+            }
+        }
+    });
+}
+
+void generate(tiled_grid &world, kind type, double chance, uint64_t seed,
+              const std::vector<std::pair<int, int>> &anchors) {
+    int width = world.width(), height = world.height();
+    // copies `rows` rows of `walls` to the map from row y0 on, a tile wide
+    // strip at a time so that the cache only ever needs one row of tiles
+    auto copy_rows = [&](const bitgrid &walls, int y0, int rows) {
+        for (int x0 = 0; x0 < width; x0 += tiled_grid::TILE_SIZE) {
+            int x1 = std::min(x0 + tiled_grid::TILE_SIZE, width);
+            for (int y = 0; y < rows; y++) {
+                for (int x = x0; x < x1; x++) {
+                    int cell = world.get(x, y0 + y);
+                    if (cell == PASSABLE || cell == IMPASSABLE)
+                        world.set(x, y0 + y,
+                                  walls.get(x, y) ? IMPASSABLE : PASSABLE);
+                }
+            }
+        }
+    };
+    if (type != kind::noise) {
+        copy_rows(walls_for(type, height, width, chance, seed, anchors), 0,
+                  height);
+        return;
+    }
+    bitgrid band(BAND_ROWS, width);
+    for (int y0 = 0; y0 < height; y0 += BAND_ROWS) {
+        int rows = std::min(BAND_ROWS, height - y0);
+        noise_band(band, y0 / BAND_ROWS, 0, rows, chance, seed);
+        for (auto [x, y] : anchors) {
+            if (y >= y0 && y < y0 + rows)
+                band.set(x, y - y0, false);
+        }
+        copy_rows(band, y0, rows);
+    }
+}
+}  // namespace gen
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "grid.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class tiled_grid;
+
+namespace gen {
+// seeded map generators; the same seed always gives the same map, whatever
+// the number of threads it was generated on
+
+enum class kind {
+    // independent cells, blocked with probability `chance` percent
+    noise,
+    // recursive division maze
+    maze,
+    // rectangular rooms joined by corridors
+    rooms,
+    // cellular automaton caves grown from `chance` percent noise
+    caves,
+};
+
+extern const std::vector<std::pair<kind, std::string>> names;
+
+std::optional<kind> parse(const std::string &name);
+const std::string &name(kind type);
+kind next(kind type);
+
+// overwrites every PASSABLE/IMPASSABLE cell of `world`; the anchors (usually
+// the start and goal) are kept open, and connected by every generator but noise
+void generate(grid<int> &world, kind type, double chance, uint64_t seed,
+              const std::vector<std::pair<int, int>> &anchors);
+// the same for a map on disk, which comes out identical to the in-memory one.
+// noise is generated a band at a time, so it never needs more than a band of
+// the map in memory; the other generators look at the whole map at once and
+// hold it as one bit per cell
+void generate(tiled_grid &world, kind type, double chance, uint64_t seed,
+              const std::vector<std::pair<int, int>> &anchors);
+}  // namespace gen
@@ -1,31 +1,144 @@
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <optional>
+#include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <fmt/core.h>
 #include <ncurses.h>
 
 #include "astar.hpp"
+#include "gen.hpp"
 #include "grid.hpp"
 #include "logs.hpp"
 #include "render.hpp"
+#include "subgoal.hpp"
+#include "tiled.hpp"
+#include "trace.hpp"
 
 // this is here because it's too little to be included in its own .cpp file
 std::stringstream note_log;
 
+// how long an anytime search may run each frame
+constexpr auto ANYTIME_BUDGET = std::chrono::microseconds(2000);
+
+// searches a map kept on disk in `path`, generating it there first unless a
+// map of this size is already in the file
+void search_tiled(const std::string &path, size_t cache_tiles, int height,
+                  int width, double chance, uint64_t seed,
+                  gen::kind generator) {
+    tiled_grid tiles(path, height, width, cache_tiles);
+    int goal_x = 1, goal_y = 1;
+    int start_x = width - 2, start_y = height - 2;
+    if (tiles.fresh()) {
+        gen::generate(tiles, generator, chance, seed,
+                      {{start_x, start_y}, {goal_x, goal_y}});
+        note_log << fmt::format("note: generated the map into {}\n", path);
+    } else {
+        // whatever an earlier search left on it goes first
+        astar::reset(tiles);
+        note_log << fmt::format("note: searching the map already in {}\n",
+                                path);
+    }
+    tiles.set(goal_x, goal_y, GOAL);
+    tiles.set(start_x, start_y, START);
+
+    astar::init(astar::node(goal_x, goal_y), astar::node(start_x, start_y),
+                tiles);
+    while (!astar::tick()) {
+    }
+    astar::term();
+    tiles.flush();
+
+    astar::stats search = astar::get_stats();
+    if (astar::success)
+        note_log << fmt::format("note: path length {} after {} nodes\n",
+                                search.path_length, search.explored_size);
+    else
+        note_log << fmt::format("note: no path after {} nodes\n",
+                                search.explored_size);
+    tiled_grid::stats cache = tiles.get_stats();
+    note_log << fmt::format(
+        "note: tile cache: {} hits, {} misses ({} prefetched), {} evictions, "
+        "{} bytes read, {} bytes written\n",
+        cache.hits, cache.misses, cache.prefetch_hits, cache.evictions,
+        cache.bytes_read, cache.bytes_written);
+}
+
 int main(int argc, char *argv[]) {
     // TODO
     // TODO spdlog
     // TODO
 
-    initscr();
-    if (!has_colors()) {
+    // flags are taken out first, leaving the positional arguments
+    std::string record_path, replay_path, tiled_path;
+    size_t cache_tiles = 256;
+    bool headless = false;
+    std::vector<char *> args{argv[0]};
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless")
+            headless = true;
+        else if (arg == "--record" && i + 1 < argc)
+            record_path = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (arg == "--subgoal-cache" && i + 1 < argc)
+            subgoal::cache_dir = argv[++i];
+        else if (arg == "--tiled" && i + 1 < argc)
+            tiled_path = argv[++i];
+        else if (arg == "--tile-cache" && i + 1 < argc)
+            cache_tiles = std::strtoull(argv[++i], nullptr, 10);
+        else
+            args.push_back(argv[i]);
+    }
+    argc = args.size();
+    argv = args.data();
+    // a map on disk is meant to be bigger than anything worth drawing
+    if (!tiled_path.empty())
+        headless = true;
+
+    // nothing is shown headless, so curses draws to /dev/null like in the
+    // bench
+    FILE *sink = nullptr;
+    SCREEN *screen = nullptr;
+    if (headless) {
+        if (!std::getenv("TERM"))
+            setenv("TERM", "xterm", 1);
+        sink = std::fopen("/dev/null", "w");
+        screen = sink ? newterm(nullptr, sink, stdin) : nullptr;
+        if (!screen) {
+            if (sink)
+                std::fclose(sink);
+            std::cout << "couldn't set up a curses screen\n";
+            return 1;
+        }
+    } else {
+        initscr();
+    }
+    auto close_screen = [&] {
         endwin();
-        std::cout << "Your terminal does not support colors :(\n";
+        if (headless) {
+            delscreen(screen);
+            std::fclose(sink);
+        }
+    };
+    auto fail = [&](const std::string &message) {
+        close_screen();
+        if (!headless)
+            std::cout << "\033[?1003l" << std::flush;
+        std::cout << message << "\n";
         return 1;
-    }
+    };
+    if (!has_colors())
+        return fail("Your terminal does not support colors :(");
     start_color();
 
     init_color(COLOR_RED, 1000, 0, 0);
@@ -56,13 +169,16 @@ int main(int argc, char *argv[]) {
 
     // this has to be all the way down here, and it only needs to exist because
     // ncurses doesn't actually REPORT_MOUSE_POSITION >:(
-    std::cout << "\033[?1003h\n" << std::flush;
+    if (!headless)
+        std::cout << "\033[?1003h\n" << std::flush;
 
     int prev_curs_mode = curs_set(1);
     int curs_active = 1;
 
     int height = 75, width = 150;
     double chance = 40.0;
+    uint64_t seed = std::random_device{}();
+    gen::kind generator = gen::kind::noise;
     bool user_input = true;
 
     if (argc == 1) {
@@ -74,30 +190,75 @@ int main(int argc, char *argv[]) {
         chance = std::atof(argv[1]);
         width = std::atoi(argv[2]);
         height = width;
-    } else if (argc == 4) {
+    } else if (argc >= 4) {
         chance = std::atof(argv[1]);
         width = std::atoi(argv[2]);
         height = std::atoi(argv[3]);
     }
+    if (argc >= 5)
+        seed = std::strtoull(argv[4], nullptr, 10);
+    if (argc >= 6) {
+        std::optional<gen::kind> parsed = gen::parse(argv[5]);
+        if (!parsed) {
+            std::string message =
+                fmt::format("Unknown generator {}, expected one of:", argv[5]);
+            for (const auto &[type, name] : gen::names)
+                message += " " + name;
+            return fail(message);
+        }
+        generator = *parsed;
+    }
 
     int x, y;
     getmaxyx(stdscr, y, x);
     y -= STATUS_LINES;
-    if (!user_input) {
-        width = x;
-        height = y;
-    } else if (width > x || height > y) {
-        note_log << "dimensions are too large, snapping to max dimensions\n";
+    // without dimensions the map fills the terminal; bigger ones are viewed
+    // through a window that the arrow keys pan
+    if (!user_input && !headless) {
         width = x;
         height = y;
     }
-    note_log << fmt::format("note: {}% fill rate and {}x{} grid\n", chance,
-                            width, height);
+    if (!tiled_path.empty()) {
+        if (!record_path.empty() || !replay_path.empty())
+            return fail("A tiled map can't be recorded or replayed");
+        if (width < 3 || height < 3)
+            return fail("A tiled map has to be at least 3x3");
+        note_log << fmt::format("note: {}% fill rate and {}x{} tiled grid\n",
+                                chance, width, height);
+        note_log << fmt::format("note: {} generator with seed {}\n",
+                                gen::name(generator), seed);
+        try {
+            search_tiled(tiled_path, cache_tiles, height, width, chance, seed,
+                         generator);
+        } catch (const std::runtime_error &error) {
+            return fail(error.what());
+        }
+    } else if (replay_path.empty()) {
+        note_log << fmt::format("note: {}% fill rate and {}x{} grid\n", chance,
+                                width, height);
+        note_log << fmt::format("note: {} generator with seed {}\n",
+                                gen::name(generator), seed);
+        render::init(height, width, curs_active, chance, seed, generator);
+    } else if (!render::init_replay(replay_path, curs_active)) {
+        return fail(fmt::format("Couldn't load a trace from {}", replay_path));
+    } else {
+        note_log << fmt::format("note: replaying {} events from {}\n",
+                                tracer::length(), replay_path);
+    }
+    if (!record_path.empty() && !tracer::start(record_path, render::world))
+        return fail(fmt::format("Couldn't record a trace to {}", record_path));
 
-    render::init(height, width, curs_active, chance);
+    if (headless && tiled_path.empty()) {
+        // run the search through without drawing, to be replayed later
+        if (!astar::done) {
+            while (!astar::tick()) {
+            }
+            astar::term();
+        }
+    }
 
     // main tui loop
-    while (true) {
+    while (!headless) {
         // computations go here
         if (render::input())
             break;
@@ -105,15 +266,25 @@ int main(int argc, char *argv[]) {
         if (astar::initialized && render::play)
             if (astar::tick())
                 astar::term();
+        render::anytime(std::chrono::steady_clock::now() + ANYTIME_BUDGET);
+        render::playback();
 
         render::draw();
         // break;
     }
 
+    if (tracer::recording) {
+        tracer::stop();
+        note_log << fmt::format("note: traced {} events in {} bytes to {}\n",
+                                tracer::get_stats().events,
+                                tracer::get_stats().bytes, record_path);
+    }
+
     note_log << "note: returning to cursor mode: " << prev_curs_mode << "\n";
     curs_set(prev_curs_mode);
-    endwin();
-    std::cout << "\033[?1003l" << std::flush;  // restore sanity
+    close_screen();
+    if (!headless)
+        std::cout << "\033[?1003l" << std::flush;  // restore sanity
 
     // at the very end, we output the log after clearing the screen to inform
     // the user of things that happened while the tui was up
@@ -1,15 +1,24 @@
 #include "render.hpp"
+#include "ara.hpp"
 #include "astar.hpp"
+#include "bitgrid.hpp"
+#include "flow.hpp"
+#include "gen.hpp"
 #include "grid.hpp"
 #include "logs.hpp"
+#include "subgoal.hpp"
+#include "theta.hpp"
+#include "trace.hpp"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <fmt/core.h>
 #include <limits>
 #include <map>
 #include <ncurses.h>
-#include <pcg_random.hpp>
-#include <random>
+#include <string_view>
 
 const int PASSABLE = 0;
 const int IMPASSABLE = 1;
@@ -27,6 +36,12 @@ const std::map<int, char> translation{
     {PASSABLE, ' '}, {IMPASSABLE, '#'}, {START, ':'}, {GOAL, '!'},
     {EXPLORED, '.'}, {QUEUE, ','},      {PATH, '*'},  {EXPLORE_PATH, '~'}};
 constexpr int STATUS_COLUMN_WIDTH = 40;
+// number of cell states, i.e. one past the largest of them
+constexpr int STATES = 8;
+// the overview's tile counts have one more slot, for overlay cells
+constexpr int OVERLAY = STATES;
+// the overview shades a tile by how much of it is impassable
+constexpr std::string_view DENSITY_RAMP = " .:-=+#%@";
 
 grid<int> world(1, 1);
 
@@ -38,22 +53,43 @@ int curs_active;
 int height, width;
 
 double chance;
-
-void fill_random(double chance) {
-    pcg_extras::seed_seq_from<std::random_device> seed_source;
-    pcg64 rng(seed_source);
-    std::uniform_int_distribution<int> dist(1, 10000);
-    for (std::vector<int> &row : world) {
-        for (int &item : row) {
-            if (item == PASSABLE) {
-                if (dist(rng) <= static_cast<int>(chance * 100)) {
-                    // rnjesus has decided that "this square shalt have block"
-                    // so it will have a block
-                    item = IMPASSABLE;
-                }
-            }
-        }
-    }
+uint64_t seed;
+gen::kind generator;
+
+// the part of the map on screen: its top left cell and its size, which is
+// the terminal's minus the status lines
+int view_x = 0, view_y = 0;
+int view_rows = 1, view_columns = 1;
+
+// the zoomed out overview fits the whole map on screen by drawing each square
+// tile of cells as one character, worked out from a count of the states in
+// it. the counts are kept up to date by update(), so drawing the overview
+// never has to look at the cells themselves
+bool overview = false;
+int tile_size = 1;
+int tiles_wide = 0, tiles_high = 0;
+std::vector<std::array<uint32_t, STATES + 1>> tiles;
+// set when cells were changed behind update()'s back
+bool tiles_stale = true;
+
+// whichever engine other than astar was used last gets the third status column
+enum class engine { none, flow, subgoal, anytime, any_angle, replay };
+engine last_engine = engine::none;
+
+// the path the other engines found last. it's drawn over the cells rather
+// than written into them, since astar takes anything that isn't PASSABLE for
+// a wall
+bitgrid overlay;
+std::vector<std::pair<int, int>> overlay_cells;
+
+// events a replay moves on by each frame while playing
+size_t replay_speed = 64;
+
+void generate_map() {
+    // every regeneration moves on to the next seed, so a run's sequence of
+    // maps can be reproduced from the seed it started with
+    gen::generate(world, generator, chance, seed++,
+                  {{start_x, start_y}, {goal_x, goal_y}});
 }
 
 std::vector<double> frame_times;
@@ -66,20 +102,230 @@ struct _update {
 bool lazy_updates;
 std::vector<_update> updates;
 
+inline std::array<uint32_t, STATES + 1> &tile_at(int x, int y) {
+    return tiles[(y / tile_size) * tiles_wide + x / tile_size];
+}
+
 void update(int x, int y, int new_val) {
-    if (!lazy_updates) {
-        world[y][x] = new_val;
+    int &cell = world[y][x];
+    if (cell == new_val)
+        return;
+    if (tracer::recording)
+        tracer::record(x, y, new_val);
+    if (!tiles_stale) {
+        std::array<uint32_t, STATES + 1> &counts = tile_at(x, y);
+        counts[cell]--;
+        counts[new_val]++;
+    }
+    if (lazy_updates)
+        updates.push_back(_update{x, y, new_val});
+    cell = new_val;
+}
+
+// for cells that look different without having changed
+inline void redraw(int x, int y) {
+    if (lazy_updates)
+        updates.push_back(_update{x, y, world[y][x]});
+}
+
+inline int ceil_div(int a, int b) { return (a + b - 1) / b; }
+
+void pan(int dx, int dy) {
+    view_x = std::clamp(view_x + dx, 0, std::max(0, width - view_columns));
+    view_y = std::clamp(view_y + dy, 0, std::max(0, height - view_rows));
+}
+
+// picks up the terminal's size, after startup or a resize
+void fit_view() {
+    getmaxyx(stdscr, view_rows, view_columns);
+    view_rows = std::max(view_rows - STATUS_LINES, 1);
+    view_columns = std::max(view_columns, 1);
+    int scale = std::max(
+        {ceil_div(width, view_columns), ceil_div(height, view_rows), 1});
+    if (scale != tile_size) {
+        tile_size = scale;
+        tiles_stale = true;
+    }
+    pan(0, 0);
+}
+
+// screen position to map cell, if there is one under it
+bool to_cell(int screen_x, int screen_y, int &x, int &y) {
+    x = view_x + screen_x;
+    y = view_y + screen_y - STATUS_LINES;
+    return !overview && screen_y >= STATUS_LINES && x >= 0 && x < width &&
+           y < height;
+}
+
+void count_tiles() {
+    tiles_wide = ceil_div(width, tile_size);
+    tiles_high = ceil_div(height, tile_size);
+    tiles.assign(static_cast<size_t>(tiles_wide) * tiles_high, {});
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++)
+            tile_at(x, y)[world[y][x]]++;
+    }
+    for (auto [x, y] : overlay_cells)
+        tile_at(x, y)[OVERLAY]++;
+    tiles_stale = false;
+}
+
+// the state cell (x, y) is drawn as
+inline int shown(int x, int y, int val) {
+    if (val != START && val != GOAL && val != IMPASSABLE && overlay.get(x, y))
+        return PATH;
+    return val;
+}
+
+inline char glyph(int x, int y, int val) {
+    if (flow::field_display && val == PASSABLE)
+        return flow::arrow(x, y);
+    return world.translate(val);
+}
+
+void draw_tile(int tile_x, int tile_y) {
+    const std::array<uint32_t, STATES + 1> &counts =
+        tiles[tile_y * tiles_wide + tile_x];
+    // the endpoints and paths stand out wherever they are
+    for (int marked : {START, GOAL, PATH, EXPLORE_PATH}) {
+        if (counts[marked] > 0 || (marked == PATH && counts[OVERLAY] > 0)) {
+            attron(COLOR_PAIR(marked));
+            mvaddch(tile_y + STATUS_LINES, tile_x, world.translate(marked));
+            return;
+        }
+    }
+    // otherwise the shade shows how much of the tile is walls, and the colour
+    // whether the search has been through it
+    uint32_t cells = 0;
+    for (int state = 0; state < STATES; state++)
+        cells += counts[state];
+    uint32_t walls = counts[IMPASSABLE];
+    size_t shade =
+        walls == 0 ? 0 : 1 + walls * (DENSITY_RAMP.size() - 2) / cells;
+    int color = PASSABLE;
+    if (counts[QUEUE] > 0)
+        color = QUEUE;
+    else if (counts[EXPLORED] > 0)
+        color = EXPLORED;
+    else if (walls > 0)
+        color = IMPASSABLE;
+    attron(COLOR_PAIR(color));
+    mvaddch(tile_y + STATUS_LINES, tile_x, DENSITY_RAMP[shade]);
+}
+
+void draw_world() {
+    int rows;
+    if (overview) {
+        if (tiles_stale)
+            count_tiles();
+        rows = std::min(tiles_high, view_rows);
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < std::min(tiles_wide, view_columns); x++)
+                draw_tile(x, y);
+            standend();
+            clrtoeol();
+        }
+    } else {
+        // only what's in view gets drawn, however big the map is
+        rows = std::min(height - view_y, view_rows);
+        int columns = std::min(width - view_x, view_columns);
+        for (int y = 0; y < rows; y++) {
+            move(y + STATUS_LINES, 0);
+            for (int x = 0; x < columns; x++) {
+                int val = shown(view_x + x, view_y + y,
+                                world[view_y + y][view_x + x]);
+                attron(COLOR_PAIR(val));
+                addch(glyph(view_x + x, view_y + y, val));
+            }
+            standend();
+            clrtoeol();
+        }
+    }
+    if (rows < view_rows) {
+        move(rows + STATUS_LINES, 0);
+        clrtobot();
+    }
+}
+
+void recompute_flow() {
+    if (flow::computed || flow::field_display)
+        flow::compute(world, goal_x, goal_y);
+}
+
+// keeps the engines that cache passability in sync after a single cell edit
+void edited(int x, int y) {
+    // the subgoal graph is for static maps; it gets rebuilt on the next query
+    subgoal::reset();
+    // an anytime search can't take back what it has already closed
+    ara::reset();
+    theta::cell_changed(x, y);
+    if (!flow::computed)
         return;
+    flow::cell_changed(x, y);
+    if (flow::field_display)
+        lazy_updates = false;  // arrows away from the edit may have turned
+}
+
+// for changes to the whole map that didn't go through update()
+void cells_rewritten() {
+    tiles_stale = true;
+    if (tracer::recording)
+        tracer::snapshot(world);
+}
+
+void clear_overlay() {
+    for (auto [x, y] : overlay_cells) {
+        overlay.set(x, y, false);
+        if (!tiles_stale)
+            tile_at(x, y)[OVERLAY]--;
+        redraw(x, y);
+    }
+    overlay_cells.clear();
+}
+
+void map_changed() {
+    cells_rewritten();
+    clear_overlay();
+    subgoal::reset();
+    theta::reset();
+    ara::reset();
+    recompute_flow();
+}
+
+// replaces the overlay with `path`
+void paint_path(const std::vector<std::pair<int, int>> &path) {
+    clear_overlay();
+    for (auto [x, y] : path) {
+        int cell = world[y][x];
+        if (cell == START || cell == GOAL || cell == IMPASSABLE ||
+            overlay.get(x, y))
+            continue;
+        overlay.set(x, y, true);
+        overlay_cells.emplace_back(x, y);
+        if (!tiles_stale)
+            tile_at(x, y)[OVERLAY]++;
+        redraw(x, y);
     }
-    if (world[y][x] == new_val)
+}
+
+size_t anytime_solutions;
+
+void anytime(std::chrono::steady_clock::time_point deadline) {
+    if (!ara::initialized || ara::done)
         return;
-    updates.push_back(_update{x, y, new_val});
-    world[y][x] = new_val;
+    ara::improve(deadline);
+    if (ara::get_stats().solutions == anytime_solutions)
+        return;
+    anytime_solutions = ara::get_stats().solutions;
+    paint_path(ara::best().path);
 }
 
-void init(int _height, int _width, int _curs_active, double _chance) {
+void init(int _height, int _width, int _curs_active, double _chance,
+          uint64_t _seed, gen::kind _generator) {
     world = grid<int>(_height, _width);
     world.set_translation(translation);
+    overlay = bitgrid(_height, _width);
+    overlay_cells.clear();
 
     goal_x = 1;
     goal_y = 1;
@@ -95,23 +341,119 @@ void init(int _height, int _width, int _curs_active, double _chance) {
                 world);
 
     chance = _chance;
-    fill_random(chance);
+    seed = _seed;
+    generator = _generator;
+    generate_map();
     height = _height;
     width = _width;
 
+    view_x = 0;
+    view_y = 0;
+    tiles_stale = true;
+    fit_view();
+
     frame_nos = 1;
     frame_times = std::vector<double>(frame_nos);
 
     updates = std::vector<_update>();
 
-    int row_idx = STATUS_LINES;
-    for (const auto &row : world) {
-        move(row_idx++, 0);
-        for (const auto &item : row) {
-            attron(COLOR_PAIR(item));
-            addch(world.translate(item));
+    draw_world();
+}
+
+bool init_replay(const std::string &path, int _curs_active) {
+    if (!tracer::load(path))
+        return false;
+    height = tracer::height();
+    width = tracer::width();
+    world = grid<int>(height, width);
+    world.set_translation(translation);
+    overlay = bitgrid(height, width);
+    overlay_cells.clear();
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            world[y][x] = tracer::initial(x, y);
+            if (world[y][x] == START) {
+                start_x = x;
+                start_y = y;
+            } else if (world[y][x] == GOAL) {
+                goal_x = x;
+                goal_y = y;
+            }
         }
     }
+    curs_active = _curs_active;
+    last_engine = engine::replay;
+
+    view_x = 0;
+    view_y = 0;
+    tiles_stale = true;
+    fit_view();
+
+    frame_nos = 1;
+    frame_times = std::vector<double>(frame_nos);
+
+    updates = std::vector<_update>();
+
+    draw_world();
+    return true;
+}
+
+void playback() {
+    if (!tracer::loaded || !play)
+        return;
+    tracer::seek(tracer::position() + replay_speed);
+    if (tracer::position() == tracer::length())
+        play = false;
+}
+
+// keys that mean something else during a replay; the ones that would run or
+// edit a search are swallowed, since the trace already has the search in it
+bool replay_input(int input) {
+    size_t scrub = std::max<size_t>(tracer::length() / 20, 1);
+    switch (input) {
+    case '+':
+        // faster
+        replay_speed = std::min<size_t>(replay_speed * 2, 1 << 24);
+        return true;
+    case '-':
+        // slower
+        replay_speed = std::max<size_t>(replay_speed / 2, 1);
+        return true;
+    case ']':
+        // scrub forwards
+        tracer::seek(tracer::position() + scrub);
+        return true;
+    case '[':
+        // scrub backwards
+        tracer::seek(tracer::position() - std::min(scrub, tracer::position()));
+        return true;
+    case '.':
+        // one event forwards
+        tracer::seek(tracer::position() + 1);
+        return true;
+    case ',':
+        // one event backwards
+        if (tracer::position() > 0)
+            tracer::seek(tracer::position() - 1);
+        return true;
+    case 'F':
+    case 'T':
+    case 'i':
+    case 's':
+    case 'S':
+    case 'c':
+    case 'f':
+    case 'g':
+    case 'b':
+    case 'l':
+    case 'a':
+    case 'd':
+    case 'm':
+    case 'r':
+    case 'R':
+        return true;
+    }
+    return false;
 }
 
 inline void status_message(const std::string &message, const int row,
@@ -188,7 +530,83 @@ void draw() {
     }
     last_render = std::chrono::high_resolution_clock::now();
 
-    status_message("render:", 0, 1);
+    if (last_engine == engine::flow && flow::computed) {
+        status_message("flow:", 0, 2);
+        flow::stats flow_stats = flow::get_stats();
+        status_message(fmt::format("field: {} cells in {:.0f}us",
+                                   flow_stats.reachable, flow_stats.compute_us),
+                       1, 2);
+        if (flow_stats.path_length > 0)
+            status_message(
+                fmt::format("path length: {}", flow_stats.path_length), 2, 2);
+        else if (flow_stats.repaired > 0)
+            status_message(fmt::format("repaired {} cells in {:.0f}us",
+                                       flow_stats.repaired,
+                                       flow_stats.repair_us),
+                           2, 2);
+    } else if (last_engine == engine::anytime && ara::initialized) {
+        ara::stats ara_stats = ara::get_stats();
+        status_message(fmt::format("ara*: epsilon {:.2f}{}", ara_stats.epsilon,
+                                   ara::done ? ", done" : ""),
+                       0, 2);
+        status_message(fmt::format("bound: {:.3f}, nodes: {}", ara_stats.bound,
+                                   ara_stats.expanded),
+                       1, 2);
+        if (ara_stats.solutions > 0)
+            status_message(
+                fmt::format("path length: {}", ara::best().path_length), 2, 2);
+        else if (ara::done)
+            status_message("no path found :(", 2, 2);
+    } else if (last_engine == engine::any_angle) {
+        theta::stats theta_stats = theta::get_stats();
+        status_message(fmt::format("lazy theta*: {} waypoints in {:.0f}us",
+                                   theta_stats.waypoints, theta_stats.query_us),
+                       0, 2);
+        status_message(fmt::format("los checks: {}, nodes: {}",
+                                   theta_stats.los_calls, theta_stats.expanded),
+                       1, 2);
+        if (theta_stats.waypoints > 0)
+            status_message(
+                fmt::format("path length: {}", theta_stats.path_length), 2, 2);
+        else
+            status_message("no path found :(", 2, 2);
+    } else if (last_engine == engine::replay && tracer::loaded) {
+        tracer::stats trace_stats = tracer::get_stats();
+        status_message(fmt::format("replay: event {}/{}{}", tracer::position(),
+                                   tracer::length(), play ? "" : ", paused"),
+                       0, 2);
+        status_message(fmt::format("speed: {} events/frame", replay_speed), 1,
+                       2);
+        status_message(fmt::format("{} keyframes, {} bytes",
+                                   trace_stats.keyframes, trace_stats.bytes),
+                       2, 2);
+    } else if (last_engine == engine::subgoal && subgoal::built) {
+        subgoal::stats subgoal_stats = subgoal::get_stats();
+        status_message(
+            fmt::format("subgoals: {}/{} {} in {:.0f}us",
+                        subgoal_stats.subgoals, subgoal_stats.edges,
+                        subgoal_stats.from_cache ? "loaded" : "built",
+                        subgoal_stats.preprocess_us),
+            0, 2);
+        status_message(fmt::format("query: {} nodes in {:.1f}us",
+                                   subgoal_stats.expanded,
+                                   subgoal_stats.query_us),
+                       1, 2);
+        if (subgoal_stats.path_length > 0)
+            status_message(
+                fmt::format("path length: {}", subgoal_stats.path_length), 2,
+                2);
+        else
+            status_message("no path found :(", 2, 2);
+    }
+
+    if (overview)
+        status_message(fmt::format("render: overview, 1:{}", tile_size), 0,
+                       1);
+    else
+        status_message(fmt::format("render: {},{} of {}x{}", view_x, view_y,
+                                   width, height),
+                       0, 1);
     // max ms is 10.3f because when using `i`, i've seen up to 100 ms :O
 
     status_message(fmt::format("frame took {:.3f}us ({:.3f}/{:.3f}/{:.3f})",
@@ -198,21 +616,26 @@ void draw() {
                                1.0 / (frame_duration / std::nano::den), max_fps,
                                avg_fps, min_fps),
                    2, 1);
-    if (!lazy_updates) {
-        int row_idx = STATUS_LINES;
-        for (const auto &row : world) {
-            move(row_idx++, 0);
-            for (const auto &item : row) {
-                attron(COLOR_PAIR(item));
-                addch(world.translate(item));
-            }
-        }
+    if (!lazy_updates || (overview && tiles_stale)) {
+        draw_world();
         lazy_updates = true;
     } else {
         for (const auto &this_update : updates) {
-            attron(COLOR_PAIR(this_update.new_val));
-            mvaddch(this_update.y + STATUS_LINES, this_update.x,
-                    world.translate(this_update.new_val));
+            if (overview) {
+                draw_tile(this_update.x / tile_size,
+                          this_update.y / tile_size);
+                continue;
+            }
+            int screen_x = this_update.x - view_x;
+            int screen_y = this_update.y - view_y;
+            if (screen_x < 0 || screen_x >= view_columns || screen_y < 0 ||
+                screen_y >= view_rows)
+                continue;
+            int val =
+                shown(this_update.x, this_update.y, this_update.new_val);
+            attron(COLOR_PAIR(val));
+            mvaddch(screen_y + STATUS_LINES, screen_x,
+                    glyph(this_update.x, this_update.y, val));
         }
         updates.clear();
     }
@@ -226,30 +649,39 @@ bool input() {
     int input = getch();
     static bool dragging_impassable;
     static bool dragging_passable;
+    int cell_x, cell_y;
+    int mouse_event_x, mouse_event_y;
 
     while (input != ERR) {
+        if (tracer::loaded && replay_input(input)) {
+            input = getch();
+            continue;
+        }
         switch (input) {
         case 'q':
             return true;
         case 'F':
             // from
-            world[start_y][start_x] = PASSABLE;
+            if (!to_cell(last_mouse_x, last_mouse_y, cell_x, cell_y))
+                break;
             update(start_x, start_y, PASSABLE);
-            start_x = last_mouse_x;
-            start_y = last_mouse_y - STATUS_LINES;
-            world[start_y][start_x] = START;
+            start_x = cell_x;
+            start_y = cell_y;
             astar::change_start(astar::node(start_x, start_y));
             update(start_x, start_y, START);
+            ara::reset();
             break;
         case 'T':
             // goal
-            world[goal_y][goal_x] = PASSABLE;
+            if (!to_cell(last_mouse_x, last_mouse_y, cell_x, cell_y))
+                break;
             update(goal_x, goal_y, PASSABLE);
-            goal_x = last_mouse_x;
-            goal_y = last_mouse_y - STATUS_LINES;
-            world[goal_y][goal_x] = GOAL;
+            goal_x = cell_x;
+            goal_y = cell_y;
             astar::change_goal(astar::node(goal_x, goal_y));
             update(goal_x, goal_y, GOAL);
+            ara::reset();
+            recompute_flow();
             break;
         case 'p':
             // play/pause
@@ -277,12 +709,54 @@ bool input() {
         case 'c':
             // clear board
             world.clear(IMPASSABLE, PASSABLE);
+            map_changed();
             lazy_updates = false;
             break;
+        case 'f':
+            // toggle displaying the flow field towards the goal
+            flow::field_display = !flow::field_display;
+            if (!flow::computed)
+                recompute_flow();
+            last_engine = engine::flow;
+            lazy_updates = false;
+            break;
+        case 'g':
+            // go: follow the flow field from the start
+            if (!flow::computed)
+                flow::compute(world, goal_x, goal_y);
+            paint_path(flow::follow(start_x, start_y));
+            last_engine = engine::flow;
+            break;
+        case 'b':
+            // subgoal graph: preprocess the map once, then query it
+            if (!subgoal::built)
+                subgoal::build(world);
+            paint_path(subgoal::query(start_x, start_y, goal_x, goal_y));
+            last_engine = engine::subgoal;
+            break;
+        case 'l':
+            // line of sight: any-angle path with lazy theta*
+            paint_path(theta::cells(
+                theta::query(world, start_x, start_y, goal_x, goal_y)));
+            last_engine = engine::any_angle;
+            break;
+        case 'a':
+            // anytime: start ara*, which then improves its path every frame
+            ara::init(world, start_x, start_y, goal_x, goal_y);
+            clear_overlay();
+            anytime_solutions = 0;
+            last_engine = engine::anytime;
+            break;
         case 'd':
             // toggle displaying path
             astar::path_display = !astar::path_display;
             break;
+        case 'm':
+            // map: switch to the next generator, then regenerate like 'r'
+            generator = gen::next(generator);
+            note_log << fmt::format("note: switched to the {} generator\n",
+                                    gen::name(generator));
+            [[fallthrough]];
         case 'r':
             // full reset: reset astar and refill grid
             // I can't use a fallthough to avoid code duplication here because
@@ -290,30 +764,70 @@ bool input() {
             astar::reset(world);
             astar::init(astar::node(goal_x, goal_y),
                         astar::node(start_x, start_y), world);
-            world.clear(IMPASSABLE, PASSABLE);
-            fill_random(chance);
+            generate_map();
+            map_changed();
             play = false;
             lazy_updates = false;
             break;
         case 'R':
             // partial reset: just reset astar
             astar::reset(world);
+            cells_rewritten();
+            clear_overlay();
+            ara::reset();
             astar::init(astar::node(goal_x, goal_y),
                         astar::node(start_x, start_y), world);
             play = false;
             lazy_updates = false;
             break;
+        case 'z':
+            // zoom: toggle the overview of the whole map
+            overview = !overview;
+            lazy_updates = false;
+            break;
+        case KEY_LEFT:
+            pan(-std::max(view_columns / 4, 1), 0);
+            lazy_updates = false;
+            break;
+        case KEY_RIGHT:
+            pan(std::max(view_columns / 4, 1), 0);
+            lazy_updates = false;
+            break;
+        case KEY_UP:
+            pan(0, -std::max(view_rows / 4, 1));
+            lazy_updates = false;
+            break;
+        case KEY_DOWN:
+            pan(0, std::max(view_rows / 4, 1));
+            lazy_updates = false;
+            break;
+        case KEY_RESIZE:
+            fit_view();
+            lazy_updates = false;
+            break;
         case KEY_MOUSE:
             MEVENT mouse_event;
             if (getmouse(&mouse_event) == OK) {
-                size_t mouse_event_x = mouse_event.x;
-                size_t mouse_event_y = mouse_event.y - STATUS_LINES;
-                if (mouse_event.bstate & BUTTON1_PRESSED) {
-                    if (mouse_event_y < world.height() &&
-                        mouse_event_x < world.width()) {
+                // a replay's map can't be edited
+                bool on_map = to_cell(mouse_event.x, mouse_event.y,
+                                      mouse_event_x, mouse_event_y) &&
+                              !tracer::loaded;
+                if (overview && mouse_event.bstate & BUTTON1_PRESSED) {
+                    // zoom back in, centred on the clicked tile
+                    overview = false;
+                    view_x = 0;
+                    view_y = 0;
+                    pan(mouse_event.x * tile_size - view_columns / 2,
+                        (mouse_event.y - STATUS_LINES) * tile_size -
+                            view_rows / 2);
+                    lazy_updates = false;
+                } else if (mouse_event.bstate & BUTTON1_PRESSED) {
+                    if (on_map) {
                         int &clicked = world[mouse_event_y][mouse_event_x];
-                        if (clicked == PASSABLE)
+                        if (clicked == PASSABLE) {
                             update(mouse_event_x, mouse_event_y, IMPASSABLE);
+                            edited(mouse_event_x, mouse_event_y);
+                        }
                         dragging_impassable = true;
                     }
                 } else if (mouse_event.bstate & BUTTON1_RELEASED) {
@@ -322,23 +836,26 @@ bool input() {
                     last_mouse_x = mouse_event.x;
                     last_mouse_y = mouse_event.y;
                 } else if (mouse_event.bstate & BUTTON3_PRESSED) {
-                    if (mouse_event_y < world.height() &&
-                        mouse_event_x < world.width()) {
+                    if (on_map) {
                         int &clicked = world[mouse_event_y][mouse_event_x];
-                        if (clicked == IMPASSABLE)
+                        if (clicked == IMPASSABLE) {
                             update(mouse_event_x, mouse_event_y, PASSABLE);
+                            edited(mouse_event_x, mouse_event_y);
+                        }
                         dragging_passable = true;
                     }
                 } else if (mouse_event.bstate & BUTTON3_RELEASED) {
                     dragging_passable = false;
                 } else if (mouse_event.bstate & REPORT_MOUSE_POSITION) {
-                    if (mouse_event_y < world.height() &&
-                        mouse_event_x < world.width()) {
+                    if (on_map) {
                         int &clicked = world[mouse_event_y][mouse_event_x];
-                        if (dragging_impassable && clicked == PASSABLE)
+                        if (dragging_impassable && clicked == PASSABLE) {
                             update(mouse_event_x, mouse_event_y, IMPASSABLE);
-                        else if (dragging_passable && clicked == IMPASSABLE)
+                            edited(mouse_event_x, mouse_event_y);
+                        } else if (dragging_passable && clicked == IMPASSABLE) {
                             update(mouse_event_x, mouse_event_y, PASSABLE);
+                            edited(mouse_event_x, mouse_event_y);
+                        }
                     }
                 }
             }
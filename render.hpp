@@ -1,5 +1,12 @@
 #pragma once
 
+#include "gen.hpp"
+#include "grid.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
 extern const int PASSABLE;
 extern const int IMPASSABLE;
 extern const int START;
@@ -15,9 +22,17 @@ namespace render {
 // contains all the code needed for rendering the grid and managing the
 // pathfinding algorithms
 extern bool play;
+extern grid<int> world;
+extern int goal_x, goal_y;
+extern int start_x, start_y;
 
 void update(int x, int y, int new_val);
-void init(int height, int width, int _curs_active, double chance);
+void anytime(std::chrono::steady_clock::time_point deadline);
+void init(int height, int width, int _curs_active, double chance,
+          uint64_t seed, gen::kind generator);
+// sets up a recorded trace to be replayed in place of a live search
+bool init_replay(const std::string &path, int _curs_active);
+void playback();
 bool input();
 void draw();
 }  // namespace render
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <utility>
+
+// the little things every search engine needs
+namespace search {
+const double SQRT2 = 1.4142135623730950488;
+
+// the straight neighbours first, then the diagonals; astar::tick() visits
+// them in this order, and the engines that store a direction store an index
+// into this
+constexpr std::pair<int, int> dirs[8] = {
+    {-1, 0}, {0, -1}, {1, 0}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+inline bool between(int val, int low, int high) {
+    return val >= low && val < high;
+}
+
+// where cell (x, y) goes in a row-major array for a map `width` cells wide
+inline size_t index(int x, int y, int width) {
+    return static_cast<size_t>(y) * width + x;
+}
+
+// the length of the shortest 8-connected path between two cells of an empty
+// map
+inline double octile(int ax, int ay, int bx, int by) {
+    int dx = std::abs(ax - bx), dy = std::abs(ay - by);
+    return std::max(dx, dy) + (SQRT2 - 1) * std::min(dx, dy);
+}
+
+inline double elapsed_us(std::chrono::high_resolution_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::high_resolution_clock::now() - since)
+               .count() /
+           1000.0;
+}
+}  // namespace search
@@ -0,0 +1,446 @@
+#include "subgoal.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+#include "bitgrid.hpp"
+#include "grid.hpp"
+#include "render.hpp"
+#include "search.hpp"
+
+namespace subgoal {
+using search::between;
+using search::elapsed_us;
+using search::index;
+using search::octile;
+
+constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t MAGIC = 0x31475353;  // "SSG1"
+
+int width = 0, height = 0;
+bitgrid open;
+std::vector<std::pair<int, int>> subgoals;
+// subgoal id of every cell, NONE for the rest
+std::vector<uint32_t> ids;
+// adjacency in compressed rows: the neighbours of subgoal i are
+// targets[offsets[i]] .. targets[offsets[i + 1]]
+std::vector<uint32_t> offsets;
+std::vector<uint32_t> targets;
+
+// query() state by subgoal id, with the start and goal in the last two
+// slots. it outlives the query, so entries left over from earlier ones are
+// told apart by their stamp
+std::vector<double> cost_so_far;
+std::vector<uint32_t> came_from;
+std::vector<uint32_t> stamps;
+uint32_t query_no = 0;
+
+bool built = false;
+std::string cache_dir;
+stats last_stats{};
+
+inline bool free_cell(int x, int y) {
+    return between(x, 0, width) && between(y, 0, height) && open.get(x, y);
+}
+
+bool is_subgoal(int x, int y) {
+    // diagonal moves only need the target free, so shortest paths bend where
+    // they squeeze diagonally past a blocked orthogonal neighbour
+    if (!free_cell(x, y))
+        return false;
+    for (int dy : {-1, 1}) {
+        for (int dx : {-1, 1}) {
+            if (free_cell(x + dx, y + dy) &&
+                (!free_cell(x + dx, y) || !free_cell(x, y + dy)))
+                return true;
+        }
+    }
+    return false;
+}
+
+// calls visit(x, y) on every cell that is directly h-reachable from (sx, sy),
+// i.e. reachable by a path of octile length that doesn't pass through another
+// subgoal. cells on the axes are visited once per quadrant they border
+void explore(int sx, int sy, const std::function<void(int, int)> &visit) {
+    for (int qy : {-1, 1}) {
+        for (int qx : {-1, 1}) {
+            // a quadrant is swept in square layers of chebyshev distance k;
+            // octile paths only ever move along the longer axis or
+            // diagonally, so layer k only depends on layer k - 1.
+            // col[j] is cell (k, j) and row[i] is cell (i, k), both in
+            // quadrant-local offsets, and hold whether the search may pass
+            // through them
+            std::vector<char> col{1}, row{1}, next_col, next_row;
+            for (int k = 1;; k++) {
+                bool any = false;
+                auto reach = [&](int i, int j, bool from) -> char {
+                    int x = sx + qx * i, y = sy + qy * j;
+                    if (!from || !free_cell(x, y))
+                        return 0;
+                    visit(x, y);
+                    bool passes = ids[index(x, y, width)] == NONE;
+                    any = any || passes;
+                    return passes;
+                };
+                next_col.assign(k + 1, 0);
+                next_row.assign(k + 1, 0);
+                for (int j = 0; j < k; j++)
+                    next_col[j] = reach(k, j, col[j] || (j > 0 && col[j - 1]));
+                for (int i = 0; i < k; i++)
+                    next_row[i] = reach(i, k, row[i] || (i > 0 && row[i - 1]));
+                next_col[k] = next_row[k] = reach(k, k, col[k - 1]);
+                if (!any)
+                    break;
+                col.swap(next_col);
+                row.swap(next_row);
+            }
+        }
+    }
+}
+
+void read_open(grid<int> &world) {
+    width = world.width();
+    height = world.height();
+    open = bitgrid(height, width);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++)
+            open.set(x, y, world[y][x] != IMPASSABLE);
+    }
+}
+
+uint64_t map_hash() {
+    // fnv-1a over the passability bits, so a saved graph is only ever loaded
+    // onto the map it was built for
+    uint64_t hash = 0xcbf29ce484222325;
+    for (int y = 0; y < height; y++) {
+        for (size_t i = 0; i < open.words(); i++) {
+            hash ^= open.row(y)[i];
+            hash *= 0x100000001b3;
+        }
+    }
+    return hash;
+}
+
+void build(grid<int> &world) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    read_open(world);
+
+    std::string cached;
+    if (!cache_dir.empty()) {
+        cached = fmt::format("{}/{}x{}-{:016x}.ssg", cache_dir, width, height,
+                             map_hash());
+        if (load(cached, world)) {
+            last_stats.from_cache = true;
+            last_stats.preprocess_us = elapsed_us(begin);
+            return;
+        }
+    }
+
+    subgoals.clear();
+    ids.assign(static_cast<size_t>(width) * height, NONE);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (is_subgoal(x, y)) {
+                ids[index(x, y, width)] = subgoals.size();
+                subgoals.emplace_back(x, y);
+            }
+        }
+    }
+
+    offsets.assign(1, 0);
+    targets.clear();
+    std::vector<uint32_t> linked(subgoals.size(), NONE);
+    for (uint32_t u = 0; u < subgoals.size(); u++) {
+        explore(subgoals[u].first, subgoals[u].second, [&](int x, int y) {
+            uint32_t v = ids[index(x, y, width)];
+            if (v != NONE && linked[v] != u) {
+                linked[v] = u;
+                targets.push_back(v);
+            }
+        });
+        offsets.push_back(targets.size());
+    }
+
+    // two extra slots for the start and goal of a query
+    cost_so_far.assign(subgoals.size() + 2, 0);
+    came_from.assign(subgoals.size() + 2, NONE);
+    stamps.assign(subgoals.size() + 2, 0);
+    query_no = 0;
+
+    last_stats = stats{};
+    last_stats.subgoals = subgoals.size();
+    last_stats.edges = targets.size() / 2;
+    last_stats.preprocess_us = elapsed_us(begin);
+    built = true;
+
+    if (!cached.empty()) {
+        // a graph that can't be cached just gets built again next time
+        std::error_code error;
+        std::filesystem::create_directories(cache_dir, error);
+        save(cached);
+    }
+}
+
+bool save(const std::string &path) {
+    if (!built)
+        return false;
+    std::ofstream out(path, std::ios::binary);
+    auto put = [&](auto val) {
+        out.write(reinterpret_cast<const char *>(&val), sizeof(val));
+    };
+    put(MAGIC);
+    put(static_cast<uint32_t>(width));
+    put(static_cast<uint32_t>(height));
+    put(map_hash());
+    put(static_cast<uint32_t>(subgoals.size()));
+    for (auto [x, y] : subgoals) {
+        put(static_cast<uint32_t>(x));
+        put(static_cast<uint32_t>(y));
+    }
+    out.write(reinterpret_cast<const char *>(offsets.data()),
+              offsets.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char *>(targets.data()),
+              targets.size() * sizeof(uint32_t));
+    return static_cast<bool>(out);
+}
+
+bool load(const std::string &path, grid<int> &world) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    std::ifstream in(path, std::ios::binary);
+    auto get = [&](auto &val) {
+        in.read(reinterpret_cast<char *>(&val), sizeof(val));
+    };
+    uint32_t magic = 0, file_width = 0, file_height = 0, count = 0;
+    uint64_t hash = 0;
+    get(magic);
+    get(file_width);
+    get(file_height);
+    get(hash);
+    if (!in || magic != MAGIC || file_width != world.width() ||
+        file_height != world.height())
+        return false;
+
+    built = false;
+    read_open(world);
+    if (hash != map_hash())
+        return false;
+
+    get(count);
+    // every subgoal is a different cell
+    if (!in || count > static_cast<size_t>(width) * height)
+        return false;
+    subgoals.resize(count);
+    ids.assign(static_cast<size_t>(width) * height, NONE);
+    for (uint32_t u = 0; u < count && in; u++) {
+        uint32_t x = 0, y = 0;
+        get(x);
+        get(y);
+        if (!is_subgoal(x, y) || ids[index(x, y, width)] != NONE)
+            return false;
+        subgoals[u] = {x, y};
+        ids[index(x, y, width)] = u;
+    }
+    offsets.resize(count + 1);
+    in.read(reinterpret_cast<char *>(offsets.data()),
+            offsets.size() * sizeof(uint32_t));
+    if (!in || offsets.front() != 0 ||
+        !std::is_sorted(offsets.begin(), offsets.end()))
+        return false;
+    // and the targets must be the rest of the file
+    std::streampos at = in.tellg();
+    in.seekg(0, std::ios::end);
+    if (in.tellg() - at != static_cast<std::streamoff>(offsets.back()) *
+                               static_cast<std::streamoff>(sizeof(uint32_t)))
+        return false;
+    in.seekg(at);
+    targets.resize(offsets.back());
+    in.read(reinterpret_cast<char *>(targets.data()),
+            targets.size() * sizeof(uint32_t));
+    if (!in || std::any_of(targets.begin(), targets.end(),
+                           [&](uint32_t v) { return v >= count; }))
+        return false;
+
+    cost_so_far.assign(count + 2, 0);
+    came_from.assign(count + 2, NONE);
+    stamps.assign(count + 2, 0);
+    query_no = 0;
+
+    last_stats = stats{};
+    last_stats.subgoals = count;
+    last_stats.edges = targets.size() / 2;
+    last_stats.preprocess_us = elapsed_us(begin);
+    built = true;
+    return true;
+}
+
+// appends the cells of an octile-length path from a to b, excluding a
+void refine(std::pair<int, int> a, std::pair<int, int> b,
+            std::vector<std::pair<int, int>> &path) {
+    auto [ax, ay] = a;
+    int dx = b.first - ax, dy = b.second - ay;
+    int sx = (dx > 0) - (dx < 0), sy = (dy > 0) - (dy < 0);
+    bool x_major = std::abs(dx) >= std::abs(dy);
+    int major = std::max(std::abs(dx), std::abs(dy));
+    int minor = std::min(std::abs(dx), std::abs(dy));
+    // after `t` steps of which `u` were diagonal
+    auto cell = [&](int t, int u) -> std::pair<int, int> {
+        return x_major ? std::pair{ax + sx * t, ay + sy * u}
+                       : std::pair{ax + sx * u, ay + sy * t};
+    };
+
+    // most segments are a straight run and a diagonal run in either order
+    for (bool diagonal_first : {true, false}) {
+        auto diagonals = [&](int t) {
+            return diagonal_first ? std::min(t, minor)
+                                  : std::max(0, t - (major - minor));
+        };
+        bool clear = true;
+        for (int t = 1; t <= major && clear; t++) {
+            auto [x, y] = cell(t, diagonals(t));
+            clear = free_cell(x, y);
+        }
+        if (clear) {
+            for (int t = 1; t <= major; t++)
+                path.push_back(cell(t, diagonals(t)));
+            return;
+        }
+    }
+
+    // otherwise find one among the rest of the octile paths in the box
+    std::vector<char> reached((major + 1) * (minor + 1), 0);
+    auto at = [&](int t, int u) -> char & {
+        return reached[t * (minor + 1) + u];
+    };
+    at(0, 0) = 1;
+    for (int t = 1; t <= major; t++) {
+        for (int u = 0; u <= std::min(t, minor); u++) {
+            auto [x, y] = cell(t, u);
+            at(t, u) = free_cell(x, y) &&
+                       (at(t - 1, u) || (u > 0 && at(t - 1, u - 1)));
+        }
+    }
+    std::vector<std::pair<int, int>> segment;
+    for (int t = major, u = minor; t > 0; t--) {
+        segment.push_back(cell(t, u));
+        if (u > 0 && at(t - 1, u - 1))
+            u--;
+    }
+    path.insert(path.end(), segment.rbegin(), segment.rend());
+}
+
+std::vector<std::pair<int, int>> query(int start_x, int start_y, int goal_x,
+                                       int goal_y) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    last_stats.expanded = 0;
+    last_stats.path_length = 0;
+    std::vector<std::pair<int, int>> path;
+    if (!built || !free_cell(start_x, start_y) || !free_cell(goal_x, goal_y))
+        return path;
+
+    // the start and goal join the graph for the duration of the query
+    const uint32_t start = subgoals.size(), goal = subgoals.size() + 1;
+    auto position = [&](uint32_t node) {
+        if (node == start)
+            return std::pair{start_x, start_y};
+        if (node == goal)
+            return std::pair{goal_x, goal_y};
+        return subgoals[node];
+    };
+
+    bool direct = start_x == goal_x && start_y == goal_y;
+    std::vector<uint32_t> from_start;
+    explore(start_x, start_y, [&](int x, int y) {
+        direct = direct || (x == goal_x && y == goal_y);
+        if (ids[index(x, y, width)] != NONE)
+            from_start.push_back(ids[index(x, y, width)]);
+    });
+    std::unordered_set<uint32_t> to_goal;
+    if (!direct) {
+        explore(goal_x, goal_y, [&](int x, int y) {
+            if (ids[index(x, y, width)] != NONE)
+                to_goal.insert(ids[index(x, y, width)]);
+        });
+        if (ids[index(goal_x, goal_y, width)] != NONE)
+            to_goal.insert(ids[index(goal_x, goal_y, width)]);
+    }
+
+    std::vector<uint32_t> waypoints;
+    if (direct) {
+        waypoints = {goal, start};
+    } else {
+        using entry = std::pair<double, uint32_t>;
+        std::priority_queue<entry, std::vector<entry>, std::greater<entry>>
+            frontier;
+        query_no++;
+        auto relax = [&](uint32_t from, uint32_t to) {
+            auto [fx, fy] = position(from);
+            auto [tx, ty] = position(to);
+            double cost = cost_so_far[from] + octile(fx, fy, tx, ty);
+            if (stamps[to] == query_no && cost_so_far[to] <= cost)
+                return;
+            stamps[to] = query_no;
+            cost_so_far[to] = cost;
+            came_from[to] = from;
+            frontier.emplace(cost + octile(tx, ty, goal_x, goal_y), to);
+        };
+
+        stamps[start] = query_no;
+        cost_so_far[start] = 0;
+        came_from[start] = NONE;
+        for (uint32_t v : from_start)
+            relax(start, v);
+        while (!frontier.empty()) {
+            auto [priority, u] = frontier.top();
+            frontier.pop();
+            auto [ux, uy] = position(u);
+            if (priority > cost_so_far[u] + octile(ux, uy, goal_x, goal_y))
+                continue;  // stale entry
+            if (u == goal)
+                break;
+            last_stats.expanded++;
+            for (uint32_t i = offsets[u]; i < offsets[u + 1]; i++)
+                relax(u, targets[i]);
+            if (to_goal.contains(u))
+                relax(u, goal);
+        }
+        if (stamps[goal] == query_no) {
+            for (uint32_t node = goal; node != NONE; node = came_from[node])
+                waypoints.push_back(node);
+        }
+    }
+
+    if (!waypoints.empty()) {
+        path.emplace_back(start_x, start_y);
+        for (size_t i = waypoints.size() - 1; i > 0; i--) {
+            auto from = position(waypoints[i]);
+            auto to = position(waypoints[i - 1]);
+            last_stats.path_length +=
+                octile(from.first, from.second, to.first, to.second);
+            refine(from, to, path);
+        }
+    }
+    last_stats.query_us = elapsed_us(begin);
+    return path;
+}
+
+void reset() {
+    built = false;
+    subgoals.clear();
+    ids.clear();
+    offsets.clear();
+    targets.clear();
+    last_stats = stats{};
+}
+
+stats get_stats() { return last_stats; }
+}  // namespace subgoal
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "grid.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace subgoal {
+// simple subgoal graph: preprocessing picks the cells that shortest paths can
+// bend around and links the pairs reachable from each other in a straight
+// octile line, so queries only search that (much smaller) graph
+
+struct stats {
+    size_t subgoals;
+    size_t edges;
+    double preprocess_us;
+    size_t expanded;
+    double query_us;
+    double path_length;
+    // whether build() found the graph in the cache instead of preprocessing
+    bool from_cache;
+};
+
+extern bool built;
+// build() saves graphs here, named after the map they were built for, and
+// loads them back instead of preprocessing the same map again. nothing is
+// ever removed from it, so it's off (empty) unless --subgoal-cache is given
+extern std::string cache_dir;
+
+void build(grid<int> &world);
+bool save(const std::string &path);
+bool load(const std::string &path, grid<int> &world);
+std::vector<std::pair<int, int>> query(int start_x, int start_y, int goal_x,
+                                       int goal_y);
+void reset();
+stats get_stats();
+}  // namespace subgoal
@@ -0,0 +1,254 @@
+#include "theta.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "bitgrid.hpp"
+#include "grid.hpp"
+#include "render.hpp"
+#include "search.hpp"
+
+namespace theta {
+using search::between;
+using search::dirs;
+using search::index;
+
+constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+
+grid<int> *current_grid = nullptr;
+int width = 0, height = 0;
+// passability by rows and by columns, so that both shallow and steep lines
+// get to test whole runs of cells per word
+bitgrid rows, columns;
+bool synced = false;
+
+// per-query search state, reused between queries; a cell's entries are only
+// valid when its stamp matches the current query
+std::vector<double> cost_so_far;
+std::vector<uint32_t> came_from;
+std::vector<uint32_t> stamps;
+std::vector<uint32_t> closed;
+uint32_t query_no = 0;
+
+stats last_stats{};
+
+inline double euclidean(size_t a, size_t b) {
+    double dx = static_cast<double>(a % width) - static_cast<double>(b % width);
+    double dy = static_cast<double>(a / width) - static_cast<double>(b / width);
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+// division rounding towards negative/positive infinity
+inline int64_t floor_div(int64_t a, int64_t b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+inline int64_t ceil_div(int64_t a, int64_t b) {
+    return a / b + (a % b != 0 && (a < 0) == (b < 0));
+}
+
+// for lines no steeper than 45 degrees, in the orientation `open` is stored
+// in: the segment between two cell centres is swept one row at a time, and in
+// each row it crosses one contiguous run of cells, which is tested against
+// the passability words in one go. a cell only counts as crossed if the line
+// passes through its interior, so grazing a corner is allowed, the same as
+// diagonal moves are
+bool sweep(const bitgrid &open, int x0, int y0, int x1, int y1) {
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+    if (y0 == y1)
+        return open.all(y0, std::min(x0, x1), std::max(x0, x1));
+
+    // x along the line at height y is x0 + (y - y0) * dx / dy; everything
+    // below is kept in units of 1 / (2 * dy) so it stays exact
+    int64_t dx = x1 - x0, dy = y1 - y0;
+    auto scaled_x = [&](int64_t twice_y) {
+        return 2 * dy * x0 + (twice_y - 2 * y0) * dx;
+    };
+    for (int r = y0; r <= y1; r++) {
+        // the part of the line inside row r, clipped to the endpoints
+        int64_t a = scaled_x(std::max(2 * r - 1, 2 * y0));
+        int64_t b = scaled_x(std::min(2 * r + 1, 2 * y1));
+        int64_t lo = floor_div(std::min(a, b) - dy, 2 * dy) + 1;
+        int64_t hi = ceil_div(std::max(a, b) + dy, 2 * dy) - 1;
+        if (!open.all(r, lo, hi))
+            return false;
+    }
+    return true;
+}
+
+bool line_of_sight(int x0, int y0, int x1, int y1) {
+    last_stats.los_calls++;
+    if (std::abs(x1 - x0) >= std::abs(y1 - y0))
+        return sweep(rows, x0, y0, x1, y1);
+    return sweep(columns, y0, x0, y1, x1);
+}
+
+void sync(grid<int> &world) {
+    current_grid = &world;
+    width = world.width();
+    height = world.height();
+    rows = bitgrid(height, width);
+    columns = bitgrid(width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            rows.set(x, y, world[y][x] != IMPASSABLE);
+            columns.set(y, x, world[y][x] != IMPASSABLE);
+        }
+    }
+    size_t cells = static_cast<size_t>(width) * height;
+    cost_so_far.assign(cells, UNREACHED);
+    came_from.assign(cells, NONE);
+    stamps.assign(cells, 0);
+    closed.assign(cells, 0);
+    query_no = 0;
+    synced = true;
+}
+
+void cell_changed(int x, int y) {
+    if (!synced)
+        return;
+    bool open = (*current_grid)[y][x] != IMPASSABLE;
+    rows.set(x, y, open);
+    columns.set(y, x, open);
+}
+
+std::vector<std::pair<int, int>> query(grid<int> &world, int start_x,
+                                       int start_y, int goal_x, int goal_y,
+                                       bool lazy) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    if (!synced || current_grid != &world)
+        sync(world);
+    last_stats = stats{};
+    std::vector<std::pair<int, int>> path;
+    if (!rows.get(start_x, start_y) || !rows.get(goal_x, goal_y))
+        return path;
+
+    query_no++;
+    auto cost = [&](uint32_t idx) {
+        return stamps[idx] == query_no ? cost_so_far[idx] : UNREACHED;
+    };
+    const uint32_t start = index(start_x, start_y, width);
+    const uint32_t goal = index(goal_x, goal_y, width);
+
+    using entry = std::pair<double, uint32_t>;  // key, index
+    std::vector<entry> open;
+    auto push_open = [&](uint32_t idx) {
+        open.emplace_back(cost_so_far[idx] + euclidean(idx, goal), idx);
+        std::push_heap(open.begin(), open.end(), std::greater<entry>());
+    };
+    auto relax = [&](uint32_t idx, uint32_t parent, double new_cost) {
+        if (new_cost >= cost(idx))
+            return;
+        stamps[idx] = query_no;
+        cost_so_far[idx] = new_cost;
+        came_from[idx] = parent;
+        push_open(idx);
+    };
+
+    stamps[start] = query_no;
+    cost_so_far[start] = 0;
+    came_from[start] = start;
+    push_open(start);
+    while (!open.empty()) {
+        auto [top_key, u] = open.front();
+        std::pop_heap(open.begin(), open.end(), std::greater<entry>());
+        open.pop_back();
+        if (closed[u] == query_no ||
+            top_key != cost_so_far[u] + euclidean(u, goal))
+            continue;  // stale entry
+
+        int ux = u % width, uy = u / width;
+        uint32_t parent = came_from[u];
+        if (lazy &&
+            !line_of_sight(parent % width, parent / width, ux, uy)) {
+            // the optimistic parent was hidden after all: fall back to the
+            // best closed neighbour, which is always in sight
+            cost_so_far[u] = UNREACHED;
+            for (auto [dx, dy] : dirs) {
+                int nx = ux + dx, ny = uy + dy;
+                if (!between(nx, 0, width) || !between(ny, 0, height))
+                    continue;
+                uint32_t n = index(nx, ny, width);
+                if (closed[n] != query_no)
+                    continue;
+                double through = cost_so_far[n] + euclidean(n, u);
+                if (through < cost_so_far[u]) {
+                    cost_so_far[u] = through;
+                    came_from[u] = n;
+                }
+            }
+            parent = came_from[u];
+        }
+        if (u == goal)
+            break;
+        closed[u] = query_no;
+        last_stats.expanded++;
+
+        for (auto [dx, dy] : dirs) {
+            int vx = ux + dx, vy = uy + dy;
+            if (!between(vx, 0, width) || !between(vy, 0, height) ||
+                !rows.get(vx, vy))
+                continue;
+            uint32_t v = index(vx, vy, width);
+            if (closed[v] == query_no)
+                continue;
+            // lazy theta* takes the parent's sight for granted until v gets
+            // expanded; plain theta* checks it right away
+            if (lazy || line_of_sight(parent % width, parent / width, vx, vy))
+                relax(v, parent, cost_so_far[parent] + euclidean(parent, v));
+            else
+                relax(v, u, cost_so_far[u] + euclidean(u, v));
+        }
+    }
+
+    if (cost(goal) != UNREACHED) {
+        last_stats.path_length = cost_so_far[goal];
+        for (uint32_t idx = goal;; idx = came_from[idx]) {
+            path.emplace_back(idx % width, idx / width);
+            if (idx == start)
+                break;
+        }
+        std::reverse(path.begin(), path.end());
+    }
+    last_stats.waypoints = path.size();
+    last_stats.query_us = search::elapsed_us(begin);
+    return path;
+}
+
+std::vector<std::pair<int, int>>
+cells(const std::vector<std::pair<int, int>> &waypoints) {
+    // the grid cells along each straight segment, for drawing
+    std::vector<std::pair<int, int>> path;
+    if (waypoints.empty())
+        return path;
+    path.push_back(waypoints.front());
+    for (size_t i = 1; i < waypoints.size(); i++) {
+        auto [x0, y0] = waypoints[i - 1];
+        auto [x1, y1] = waypoints[i];
+        int steps = std::max(std::abs(x1 - x0), std::abs(y1 - y0));
+        for (int t = 1; t <= steps; t++) {
+            path.emplace_back(
+                x0 + static_cast<int>(std::lround(
+                         static_cast<double>(x1 - x0) * t / steps)),
+                y0 + static_cast<int>(std::lround(
+                         static_cast<double>(y1 - y0) * t / steps)));
+        }
+    }
+    return path;
+}
+
+void reset() {
+    synced = false;
+    current_grid = nullptr;
+}
+
+stats get_stats() { return last_stats; }
+}  // namespace theta
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "grid.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace theta {
+// any-angle paths: theta* lets a cell's parent be any cell it can see, not
+// just a neighbour, so paths run straight instead of zig-zagging along the 8
+// grid directions. the lazy variant only checks line of sight when a cell is
+// expanded rather than every time it's reached
+
+struct stats {
+    size_t los_calls;
+    size_t expanded;
+    size_t waypoints;
+    double query_us;
+    double path_length;
+};
+
+bool line_of_sight(int x0, int y0, int x1, int y1);
+std::vector<std::pair<int, int>> query(grid<int> &world, int start_x,
+                                       int start_y, int goal_x, int goal_y,
+                                       bool lazy = true);
+std::vector<std::pair<int, int>>
+cells(const std::vector<std::pair<int, int>> &waypoints);
+void cell_changed(int x, int y);
+void reset();
+stats get_stats();
+}  // namespace theta
@@ -0,0 +1,265 @@
+#include "tiled.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logs.hpp"
+
+constexpr uint32_t MAGIC = 0x31444954;  // "TID1"
+// how far the prefetcher may get ahead: queued requests, and tiles read but
+// not yet asked for
+constexpr size_t MAX_REQUESTS = 16;
+constexpr size_t MAX_STAGED = 64;
+
+template <typename T>
+tiled_array<T>::tiled_array(const std::string &path, int height, int width,
+                            size_t cache_tiles)
+    : _path(path), _height(height), _width(width),
+      tiles_wide((width + TILE_SIZE - 1) / TILE_SIZE),
+      tiles_high((height + TILE_SIZE - 1) / TILE_SIZE) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw std::runtime_error("couldn't open tiled map " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("couldn't open tiled map " + path);
+    }
+
+    // the header takes up the first tile's worth of bytes so that the tiles
+    // themselves stay aligned
+    uint32_t header[4] = {};
+    uint32_t expected[4] = {MAGIC, static_cast<uint32_t>(width),
+                            static_cast<uint32_t>(height), TILE_SIZE};
+    off_t size = static_cast<off_t>(tiles_wide * tiles_high + 1) *
+                 static_cast<off_t>(TILE_BYTES);
+    if (info.st_size == 0) {
+        // a new array: the file is sparse, and reads back as zeroes, which
+        // for a map is PASSABLE
+        if (ftruncate(fd, size) != 0 ||
+            pwrite(fd, expected, sizeof(expected), 0) != sizeof(expected)) {
+            close(fd);
+            throw std::runtime_error("couldn't create tiled map " + path);
+        }
+        _fresh = true;
+    } else if (pread(fd, header, sizeof(header), 0) != sizeof(header) ||
+               header[0] != MAGIC || header[3] != TILE_SIZE) {
+        // anything else in the file is left alone
+        close(fd);
+        throw std::runtime_error(path + " isn't a tiled map");
+    } else if (!std::equal(header, header + 4, expected)) {
+        close(fd);
+        throw std::runtime_error(fmt::format(
+            "{} holds a {}x{} map, not {}x{}", path, header[1], header[2],
+            width, height));
+    } else if (info.st_size != size) {
+        // the right dimensions, but values of another size
+        close(fd);
+        throw std::runtime_error(path + " isn't a tiled map");
+    }
+
+    cache_tiles = std::max<size_t>(cache_tiles, 1);
+    data.assign(cache_tiles * TILE_CELLS, T{});
+    slot_tile.assign(cache_tiles, NONE);
+    dirty.assign(cache_tiles, false);
+    prefetcher = std::thread(&tiled_array::prefetch_loop, this);
+}
+
+template <typename T> tiled_array<T>::~tiled_array() {
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+        stopping = true;
+    }
+    prefetch_ready.notify_one();
+    prefetcher.join();
+    // a destructor can't throw, so tiles that can't be written back are only
+    // noted; call flush() first to get the error
+    size_t lost = 0;
+    for (size_t slot = 0; slot < slot_tile.size(); slot++) {
+        try {
+            if (slot_tile[slot] != NONE)
+                write_back(slot);
+        } catch (const std::runtime_error &) {
+            lost++;
+        }
+    }
+    if (lost > 0)
+        note_log << fmt::format(
+            "note: {} changed tiles couldn't be written back to the map\n",
+            lost);
+    close(fd);
+}
+
+template <typename T>
+void tiled_array<T>::read_tile(uint32_t tile, T *out) {
+    off_t offset = static_cast<off_t>(tile + 1) * TILE_BYTES;
+    ssize_t got = pread(fd, out, TILE_BYTES, offset);
+    // anything past the end of the file reads as zeroes (PASSABLE)
+    if (got < static_cast<ssize_t>(TILE_BYTES))
+        std::memset(reinterpret_cast<char *>(out) + std::max<ssize_t>(got, 0),
+                    0, TILE_BYTES - std::max<ssize_t>(got, 0));
+}
+
+template <typename T> void tiled_array<T>::write_back(size_t slot) {
+    if (!dirty[slot])
+        return;
+    off_t offset = static_cast<off_t>(slot_tile[slot] + 1) * TILE_BYTES;
+    if (pwrite(fd, &data[slot * TILE_CELLS], TILE_BYTES, offset) !=
+        static_cast<ssize_t>(TILE_BYTES))
+        throw std::runtime_error(fmt::format("couldn't write back a tile: {}",
+                                             std::strerror(errno)));
+    counters.bytes_written += TILE_BYTES;
+    dirty[slot] = false;
+}
+
+template <typename T> size_t tiled_array<T>::load(uint32_t tile) {
+    size_t slot;
+    if (slots.size() < slot_tile.size()) {
+        slot = slots.size();
+    } else {
+        uint32_t victim = lru.back();
+        lru.pop_back();
+        lru_pos.erase(victim);
+        slot = slots[victim];
+        slots.erase(victim);
+        write_back(slot);
+        counters.evictions++;
+        // only now that it's on disk may the prefetcher read it again
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+        resident.erase(victim);
+    }
+
+    T *out = &data[slot * TILE_CELLS];
+    bool was_staged = false;
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+        resident.insert(tile);
+        if (reading == tile)
+            reading_stale = true;
+        auto found = staged.find(tile);
+        if (found != staged.end()) {
+            std::copy(found->second.begin(), found->second.end(), out);
+            staged.erase(found);
+            was_staged = true;
+        }
+    }
+    if (was_staged) {
+        counters.prefetch_hits++;
+    } else {
+        read_tile(tile, out);
+        counters.bytes_read += TILE_BYTES;
+    }
+
+    slot_tile[slot] = tile;
+    dirty[slot] = false;
+    slots[tile] = slot;
+    lru.push_front(tile);
+    lru_pos[tile] = lru.begin();
+    return slot;
+}
+
+template <typename T> void tiled_array<T>::switch_to(uint32_t tile) {
+    auto found = slots.find(tile);
+    if (found != slots.end()) {
+        counters.hits++;
+        last_slot = found->second;
+        lru.splice(lru.begin(), lru, lru_pos[tile]);
+    } else {
+        counters.misses++;
+        last_slot = load(tile);
+    }
+    last_tile = tile;
+    last_data = &data[last_slot * TILE_CELLS];
+}
+
+template <typename T>
+void tiled_array<T>::prefetch(int x, int y, int dx, int dy) {
+    int ahead_x = x + dx * (TILE_SIZE / 2);
+    int ahead_y = y + dy * (TILE_SIZE / 2);
+    if (ahead_x < 0 || ahead_y < 0 || ahead_x >= static_cast<int>(_width) ||
+        ahead_y >= static_cast<int>(_height))
+        return;
+    uint32_t tile = (ahead_y / TILE_SIZE) * tiles_wide + ahead_x / TILE_SIZE;
+    if (tile == last_tile || slots.count(tile))
+        return;
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+        if (requests.size() >= MAX_REQUESTS || staged.count(tile) ||
+            std::find(requests.begin(), requests.end(), tile) !=
+                requests.end())
+            return;
+        requests.push_back(tile);
+    }
+    prefetch_ready.notify_one();
+}
+
+template <typename T> void tiled_array<T>::prefetch_loop() {
+    std::vector<T> buffer(TILE_CELLS);
+    std::unique_lock<std::mutex> lock(prefetch_mutex);
+    while (true) {
+        prefetch_ready.wait(lock,
+                            [&] { return !requests.empty() || stopping; });
+        if (stopping)
+            return;
+        uint32_t tile = requests.front();
+        requests.pop_front();
+        if (resident.count(tile) || staged.count(tile))
+            continue;
+        reading = tile;
+        reading_stale = false;
+        lock.unlock();
+        read_tile(tile, buffer.data());
+        background_bytes += TILE_BYTES;
+        lock.lock();
+        if (!reading_stale) {
+            if (staged.size() >= MAX_STAGED)
+                staged.erase(staged.begin());
+            staged.emplace(tile, buffer);
+            background_tiles++;
+        }
+        reading = NONE;
+    }
+}
+
+template <typename T> void tiled_array<T>::clear(T val, T replacement) {
+    for (size_t tile_y = 0; tile_y < tiles_high; tile_y++) {
+        for (size_t tile_x = 0; tile_x < tiles_wide; tile_x++) {
+            int x0 = tile_x * TILE_SIZE, y0 = tile_y * TILE_SIZE;
+            int x1 = std::min<int>(x0 + TILE_SIZE, _width);
+            int y1 = std::min<int>(y0 + TILE_SIZE, _height);
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    if (get(x, y) == val)
+                        set(x, y, replacement);
+                }
+            }
+        }
+    }
+}
+
+template <typename T> void tiled_array<T>::flush() {
+    for (size_t slot = 0; slot < slot_tile.size(); slot++) {
+        if (slot_tile[slot] != NONE)
+            write_back(slot);
+    }
+}
+
+template <typename T>
+typename tiled_array<T>::stats tiled_array<T>::get_stats() const {
+    stats current = counters;
+    current.prefetched = background_tiles;
+    current.bytes_read += background_bytes;
+    return current;
+}
+
+// the map, and astar's search state for it
+template class tiled_array<uint8_t>;
+template class tiled_array<double>;
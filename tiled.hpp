@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// an array the size of a map kept on disk, for maps too big to hold in
+// memory. the file is split into square tiles of TILE_SIZE x TILE_SIZE
+// values, and only a fixed number of them are cached at a time; the least
+// recently used one is written back (if it changed) to make room for the
+// next. a background thread reads tiles ahead of time when asked to with
+// prefetch()
+template <typename T> class tiled_array {
+ public:
+    static constexpr int TILE_SIZE = 64;
+    static constexpr size_t TILE_CELLS = TILE_SIZE * TILE_SIZE;
+    static constexpr size_t TILE_BYTES = TILE_CELLS * sizeof(T);
+
+    // a hit or a miss is counted each time access moves on to another tile
+    struct stats {
+        size_t hits;
+        size_t misses;
+        // misses that found the tile already read by the prefetcher
+        size_t prefetch_hits;
+        size_t prefetched;
+        size_t evictions;
+        size_t bytes_read;
+        size_t bytes_written;
+    };
+
+    // opens the array at `path`, or creates it with every value zero if the
+    // file doesn't exist or is empty. throws if the file can't be used, or
+    // holds anything other than an array of these dimensions, which is left
+    // as it was
+    tiled_array(const std::string &path, int height, int width,
+                size_t cache_tiles = 256);
+    ~tiled_array();
+    tiled_array(const tiled_array &) = delete;
+    tiled_array &operator=(const tiled_array &) = delete;
+
+    inline T get(int x, int y) { return cell(x, y); }
+
+    inline void set(int x, int y, T val) {
+        cell(x, y) = val;
+        dirty[last_slot] = true;
+    }
+
+    inline size_t height() const { return _height; }
+    inline size_t width() const { return _width; }
+    inline const std::string &path() const { return _path; }
+    inline size_t cache_tiles() const { return slot_tile.size(); }
+    // whether the constructor had to create the file
+    inline bool fresh() const { return _fresh; }
+
+    // asks for the tile `TILE_SIZE / 2` cells on from (x, y) in direction
+    // (dx, dy) to be read in the background, if it isn't cached already
+    void prefetch(int x, int y, int dx, int dy);
+    // replaces every `val` with `replacement`, a tile at a time
+    void clear(T val, T replacement);
+    // writes back every changed tile
+    void flush();
+    // forgets every change that hasn't been written back yet, for arrays that
+    // are only scratch space
+    inline void discard() { std::fill(dirty.begin(), dirty.end(), false); }
+    stats get_stats() const;
+
+ private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    std::string _path;
+    size_t _height, _width;
+    size_t tiles_wide, tiles_high;
+    int fd = -1;
+    bool _fresh = false;
+
+    // the cache: slot i holds tile slot_tile[i] at data[i * TILE_CELLS]
+    std::vector<T> data;
+    std::vector<uint32_t> slot_tile;
+    std::vector<bool> dirty;
+    std::unordered_map<uint32_t, size_t> slots;
+    // most recently used tile first
+    std::list<uint32_t> lru;
+    std::unordered_map<uint32_t, std::list<uint32_t>::iterator> lru_pos;
+    // the tile the last access went to, which skips the lookup
+    uint32_t last_tile = NONE;
+    size_t last_slot = 0;
+    T *last_data = nullptr;
+
+    // shared with the prefetch thread
+    std::mutex prefetch_mutex;
+    std::condition_variable prefetch_ready;
+    std::deque<uint32_t> requests;
+    std::unordered_map<uint32_t, std::vector<T>> staged;
+    std::unordered_set<uint32_t> resident;
+    // the tile being read right now, and whether it was loaded into the cache
+    // in the meantime (so that the read may be older than the cached copy)
+    uint32_t reading = NONE;
+    bool reading_stale = false;
+    bool stopping = false;
+    std::thread prefetcher;
+
+    stats counters{};
+    std::atomic<size_t> background_bytes{0};
+    std::atomic<size_t> background_tiles{0};
+
+    inline T &cell(int x, int y) {
+        uint32_t tile = (y / TILE_SIZE) * tiles_wide + x / TILE_SIZE;
+        if (tile != last_tile)
+            switch_to(tile);
+        return last_data[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+    }
+
+    void switch_to(uint32_t tile);
+    size_t load(uint32_t tile);
+    void write_back(size_t slot);
+    void read_tile(uint32_t tile, T *out);
+    void prefetch_loop();
+};
+
+// the map itself, one cell state per byte. a class of its own so that it can
+// be declared ahead
+class tiled_grid : public tiled_array<uint8_t> {
+ public:
+    using tiled_array::tiled_array;
+};
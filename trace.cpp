@@ -0,0 +1,304 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "grid.hpp"
+#include "render.hpp"
+
+namespace tracer {
+constexpr uint32_t MAGIC = 0x31525450;  // "PTR1"
+// the low bits of every event hold the new state, the rest the index delta
+constexpr int STATE_BITS = 4;
+constexpr uint64_t STATE_MASK = (1 << STATE_BITS) - 1;
+// not a cell state: marks a snapshot of the whole map
+constexpr uint64_t SNAPSHOT = STATE_MASK;
+// cell states are all below this
+constexpr int STATES = 8;
+// buffers are handed to the writer thread once they're this full
+constexpr size_t BUFFER_BYTES = 1 << 16;
+// playback keeps a copy of the map at least this many events apart
+constexpr size_t MIN_KEYFRAME_INTERVAL = 1 << 16;
+
+bool recording = false;
+bool loaded = false;
+
+stats last_stats{};
+
+// recording state
+int trace_width = 0;
+int64_t last_cell = 0;
+std::vector<uint8_t> buffer;
+std::ofstream out;
+std::thread writer;
+std::mutex queue_mutex;
+std::condition_variable queue_ready;
+// full buffers waiting to be written, and written ones to be reused
+std::deque<std::vector<uint8_t>> full;
+std::vector<std::vector<uint8_t>> spare;
+bool finishing = false;
+
+// playback state: the events, what each one overwrote so it can be undone,
+// and keyframes every `interval` events so far jumps don't have to replay
+// (or undo) everything in between
+size_t play_width = 0, play_height = 0;
+std::vector<uint32_t> cells;
+std::vector<uint8_t> states;
+std::vector<uint8_t> previous;
+std::vector<std::vector<uint8_t>> keyframes;
+size_t interval = MIN_KEYFRAME_INTERVAL;
+size_t played = 0;
+
+inline uint64_t zigzag(int64_t val) {
+    return (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63);
+}
+
+inline int64_t unzigzag(uint64_t val) {
+    return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+}
+
+inline void put_varint(uint64_t val) {
+    while (val >= 0x80) {
+        buffer.push_back(static_cast<uint8_t>(val | 0x80));
+        val >>= 7;
+    }
+    buffer.push_back(static_cast<uint8_t>(val));
+}
+
+void write_loop() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (true) {
+        queue_ready.wait(lock, [] { return !full.empty() || finishing; });
+        if (full.empty())
+            return;
+        std::vector<uint8_t> chunk = std::move(full.front());
+        full.pop_front();
+        lock.unlock();
+        out.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+        chunk.clear();
+        lock.lock();
+        spare.push_back(std::move(chunk));
+    }
+}
+
+void hand_off() {
+    last_stats.bytes += buffer.size();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        full.push_back(std::move(buffer));
+        if (spare.empty()) {
+            buffer = std::vector<uint8_t>();
+        } else {
+            buffer = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    queue_ready.notify_one();
+    buffer.reserve(BUFFER_BYTES + 16);
+}
+
+bool start(const std::string &path, grid<int> &world) {
+    if (recording)
+        stop();
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    auto put = [&](auto val) {
+        out.write(reinterpret_cast<const char *>(&val), sizeof(val));
+    };
+    put(MAGIC);
+    put(static_cast<uint32_t>(world.width()));
+    put(static_cast<uint32_t>(world.height()));
+    trace_width = world.width();
+    last_stats = stats{};
+    last_stats.bytes = 3 * sizeof(uint32_t);
+
+    buffer.clear();
+    buffer.reserve(BUFFER_BYTES + 16);
+    finishing = false;
+    recording = true;
+    writer = std::thread(write_loop);
+    snapshot(world);
+    return true;
+}
+
+void record(int x, int y, int state) {
+    int64_t cell = static_cast<int64_t>(y) * trace_width + x;
+    put_varint((zigzag(cell - last_cell) << STATE_BITS) |
+               static_cast<uint64_t>(state));
+    last_cell = cell;
+    last_stats.events++;
+    if (buffer.size() >= BUFFER_BYTES)
+        hand_off();
+}
+
+void snapshot(grid<int> &world) {
+    put_varint(SNAPSHOT);
+    for (std::vector<int> &row : world) {
+        for (int cell : row)
+            buffer.push_back(static_cast<uint8_t>(cell));
+        if (buffer.size() >= BUFFER_BYTES)
+            hand_off();
+    }
+    last_cell = 0;
+}
+
+void stop() {
+    if (!recording)
+        return;
+    hand_off();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        finishing = true;
+    }
+    queue_ready.notify_one();
+    writer.join();
+    out.close();
+    recording = false;
+}
+
+// moves the map to the state it was in before event `keyframe * interval`
+void restore(size_t keyframe) {
+    const std::vector<uint8_t> &frame = keyframes[keyframe];
+    for (size_t y = 0; y < play_height; y++) {
+        for (size_t x = 0; x < play_width; x++)
+            render::update(x, y, frame[y * play_width + x]);
+    }
+    played = keyframe * interval;
+}
+
+bool decode(const std::vector<uint8_t> &data) {
+    uint32_t header[3] = {};
+    if (data.size() < sizeof(header))
+        return false;
+    std::copy_n(data.begin(), sizeof(header),
+                reinterpret_cast<uint8_t *>(header));
+    if (header[0] != MAGIC || header[1] == 0 || header[2] == 0)
+        return false;
+    play_width = header[1];
+    play_height = header[2];
+    size_t map_size = play_width * play_height;
+    // a keyframe costs as much as one event per cell to restore, so this
+    // keeps them from taking up more memory than the events do
+    interval = std::max(MIN_KEYFRAME_INTERVAL, map_size);
+
+    // events are decoded against the current state of the map so that each
+    // one knows what it overwrote; snapshots become one event per changed cell
+    std::vector<uint8_t> current;
+    int64_t cell = 0;
+    size_t at = sizeof(header);
+    auto add_event = [&](size_t idx, uint8_t state) {
+        if (cells.size() % interval == 0)
+            keyframes.push_back(current);
+        cells.push_back(idx);
+        states.push_back(state);
+        previous.push_back(current[idx]);
+        current[idx] = state;
+    };
+    while (at < data.size()) {
+        uint64_t val = 0;
+        for (int shift = 0;; shift += 7) {
+            if (at >= data.size() || shift > 63)
+                return false;
+            val |= static_cast<uint64_t>(data[at] & 0x7f) << shift;
+            if (!(data[at++] & 0x80))
+                break;
+        }
+
+        if (val == SNAPSHOT) {
+            if (data.size() - at < map_size ||
+                std::any_of(data.begin() + at, data.begin() + at + map_size,
+                            [](uint8_t state) { return state >= STATES; }))
+                return false;
+            if (current.empty()) {
+                current.assign(data.begin() + at, data.begin() + at + map_size);
+            } else {
+                for (size_t idx = 0; idx < map_size; idx++) {
+                    if (data[at + idx] != current[idx])
+                        add_event(idx, data[at + idx]);
+                }
+            }
+            at += map_size;
+            cell = 0;
+            continue;
+        }
+
+        cell += unzigzag(val >> STATE_BITS);
+        uint64_t state = val & STATE_MASK;
+        if (current.empty() || cell < 0 ||
+            static_cast<size_t>(cell) >= map_size || state >= STATES)
+            return false;
+        add_event(cell, state);
+    }
+    if (current.empty())
+        return false;
+    if (cells.size() % interval == 0)
+        keyframes.push_back(current);  // so a keyframe always covers the end
+    return true;
+}
+
+bool load(const std::string &path) {
+    reset();
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data{std::istreambuf_iterator<char>(in),
+                              std::istreambuf_iterator<char>()};
+    if (!decode(data)) {
+        reset();
+        return false;
+    }
+    last_stats = stats{cells.size(), data.size(), keyframes.size(), interval};
+    played = 0;
+    loaded = true;
+    return true;
+}
+
+size_t width() { return play_width; }
+size_t height() { return play_height; }
+
+int initial(int x, int y) { return keyframes[0][y * play_width + x]; }
+
+size_t position() { return played; }
+size_t length() { return cells.size(); }
+
+void seek(size_t event) {
+    if (!loaded)
+        return;
+    event = std::min(event, cells.size());
+    // restoring the keyframe before the target and replaying from there costs
+    // about a map's worth of updates plus the events since the keyframe;
+    // take that whenever stepping there one event at a time would cost more
+    size_t keyframe = event / interval;
+    size_t via_keyframe =
+        event - keyframe * interval + play_width * play_height;
+    size_t direct = event > played ? event - played : played - event;
+    if (direct > via_keyframe)
+        restore(keyframe);
+    for (; played < event; played++) {
+        uint32_t idx = cells[played];
+        render::update(idx % play_width, idx / play_width, states[played]);
+    }
+    for (; played > event; played--) {
+        uint32_t idx = cells[played - 1];
+        render::update(idx % play_width, idx / play_width,
+                       previous[played - 1]);
+    }
+}
+
+void reset() {
+    loaded = false;
+    cells.clear();
+    states.clear();
+    previous.clear();
+    keyframes.clear();
+    played = 0;
+}
+
+stats get_stats() { return last_stats; }
+}  // namespace tracer
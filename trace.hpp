@@ -0,0 +1,49 @@
+#pragma once
+
+#include "grid.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace tracer {
+// search traces: every cell change that goes through render::update() can be
+// recorded to a compact binary file, which can be played back later at any
+// speed and scrubbed in both directions without running the search again.
+//
+// a trace is a header (magic, width, height), a snapshot of the map, and then
+// one varint per event holding the zigzagged change in cell index since the
+// previous event together with the cell's new state. map-wide changes that
+// don't go through update() are recorded as a fresh snapshot
+
+struct stats {
+    size_t events;
+    size_t bytes;
+    // playback only
+    size_t keyframes;
+    size_t keyframe_interval;
+};
+
+// recording; the file is written by a background thread, so record() only
+// appends to a buffer
+extern bool recording;
+
+bool start(const std::string &path, grid<int> &world);
+void record(int x, int y, int state);
+void snapshot(grid<int> &world);
+void stop();
+
+// playback; events are applied and undone through render::update()
+extern bool loaded;
+
+bool load(const std::string &path);
+size_t width();
+size_t height();
+// the state of cell (x, y) before the first event
+int initial(int x, int y);
+size_t position();
+size_t length();
+void seek(size_t event);
+void reset();
+
+stats get_stats();
+}  // namespace tracer